@@ -0,0 +1,467 @@
+/*** gperf.c -- reading gperf input files
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of phashist.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined _GNU_SOURCE
+# define _GNU_SOURCE
+#endif	/* !_GNU_SOURCE */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "nifty.h"
+#include "keys.h"
+#include "gperf.h"
+
+struct gperf_clo_s {
+	const char *fn;
+	phgperf_t gp;
+};
+
+/* growable strings */
+typedef struct {
+	char *s;
+	size_t n;
+	size_t z;
+} gpbuf_t;
+
+
+static __attribute__((format(printf, 3, 4))) void
+gperf_error(const char *fn, size_t lno, const char *fmt, ...)
+{
+	va_list vap;
+
+	fprintf(stderr, "%s:%zu: ", fn ?: "-", lno);
+	va_start(vap, fmt);
+	vfprintf(stderr, fmt, vap);
+	va_end(vap);
+	fputc('\n', stderr);
+	return;
+}
+
+static void
+gpbuf_add(gpbuf_t *b, const void *s, size_t n)
+{
+	if (b->n + n + 1U > b->z) {
+		while ((b->z = b->z * 2U ?: 256U) < b->n + n + 1U);
+		b->s = realloc(b->s, b->z);
+	}
+	memcpy(b->s + b->n, s, n);
+	b->s[b->n += n] = '\0';
+	return;
+}
+
+static bool
+gperf_linep(const uint8_t *bp, const uint8_t *ep, const char *s)
+{
+/* return true if the line BP..EP is S, save for trailing whitespace */
+	const size_t z = strlen(s);
+
+	if ((size_t)(ep - bp) < z || memcmp(bp, s, z)) {
+		return false;
+	}
+	for (bp += z; bp < ep && (*bp == ' ' || *bp == '\t'); bp++);
+	return bp == ep;
+}
+
+static const uint8_t*
+gperf_word(const uint8_t *bp, const uint8_t *ep, const uint8_t **wp)
+{
+/* skip whitespace, then return the end of the word starting at *WP */
+	for (; bp < ep && (*bp == ' ' || *bp == '\t'); bp++);
+	*wp = bp;
+	for (; bp < ep && *bp != ' ' && *bp != '\t' && *bp != '='; bp++);
+	return bp;
+}
+
+static unsigned int
+gperf_unesc(const uint8_t **rp, const uint8_t *ep)
+{
+/* decode the C escape sequence after the backslash at *RP */
+	const uint8_t *p = *rp + 1U;
+	unsigned int c;
+
+	switch ((c = *p++)) {
+	case 'a':
+		c = '\a';
+		break;
+	case 'b':
+		c = '\b';
+		break;
+	case 'f':
+		c = '\f';
+		break;
+	case 'n':
+		c = '\n';
+		break;
+	case 'r':
+		c = '\r';
+		break;
+	case 't':
+		c = '\t';
+		break;
+	case 'v':
+		c = '\v';
+		break;
+	case 'x':
+		for (c = 0U; p < ep; p++) {
+			if (*p >= '0' && *p <= '9') {
+				c = c * 16U + (*p - '0');
+			} else if ((*p | 0x20U) >= 'a' && (*p | 0x20U) <= 'f') {
+				c = c * 16U + ((*p | 0x20U) - 'a' + 10U);
+			} else {
+				break;
+			}
+		}
+		break;
+	case '0' ... '7':
+		c -= '0';
+		for (size_t i = 1U; i < 3U && p < ep && *p >= '0' && *p <= '7';
+		     i++, p++) {
+			c = c * 8U + (*p - '0');
+		}
+		break;
+	default:
+		/* \\, \", \' and \? and anything else stands for itself */
+		break;
+	}
+	*rp = p;
+	return c & 0xffU;
+}
+
+static int
+gperf_decl(const struct gperf_clo_s *clo, size_t lno,
+	   const uint8_t *bp, const uint8_t *ep, bool *structp)
+{
+/* digest the %-declaration BP..EP */
+	const phgperf_t gp = clo->gp;
+	const uint8_t *wp, *we;
+
+	we = gperf_word(bp + 1U, ep, &wp);
+	if (0) {
+		;
+	} else if (we - wp == 11 && !memcmp(wp, "struct-type", 11U)) {
+		*structp = true;
+	} else if (we - wp == 16 && !memcmp(wp, "omit-struct-type", 16U)) {
+		gp->omit_struct = true;
+	} else if (we - wp == 11 && !memcmp(wp, "ignore-case", 11U)) {
+		gperf_error(clo->fn, lno, "%%ignore-case is not supported");
+		return -1;
+	} else if (we - wp == 6 && !memcmp(wp, "define", 6U)) {
+		const uint8_t *vp, *ve;
+		char **tgt;
+
+		we = gperf_word(we, ep, &wp);
+		ve = gperf_word(we, ep, &vp);
+		if (0) {
+			;
+		} else if (we - wp == 20 &&
+			   !memcmp(wp, "lookup-function-name", 20U)) {
+			tgt = &gp->lookup;
+		} else if (we - wp == 15 &&
+			   !memcmp(wp, "word-array-name", 15U)) {
+			tgt = &gp->wordlist;
+		} else if (we - wp == 9 && !memcmp(wp, "slot-name", 9U)) {
+			tgt = &gp->slot;
+		} else {
+			/* naming things we don't emit */
+			return 0;
+		}
+		if (vp == ve) {
+			gperf_error(clo->fn, lno, "%%define without a value");
+			return -1;
+		}
+		free(*tgt);
+		*tgt = strndup((const char*)vp, ve - vp);
+	}
+	/* everything else is about gperf's own table layout */
+	return 0;
+}
+
+static char*
+gperf_stag(const char *decl)
+{
+/* return the tag of the first struct declared in DECL */
+	for (const char *sp = decl; (sp = strstr(sp, "struct")) != NULL;) {
+		const char *tp, *te;
+
+		if (sp > decl && (sp[-1] == '_' || isalnum((unsigned char)sp[-1]))) {
+			sp++;
+			continue;
+		}
+		for (tp = sp += 6U; isspace((unsigned char)*tp); tp++);
+		for (te = tp; *te == '_' || isalnum((unsigned char)*te); te++);
+		if (te > tp && tp > sp) {
+			return strndup(tp, te - tp);
+		}
+	}
+	return NULL;
+}
+
+static phvec_t
+gperf_split(uint8_t *buf, size_t bsz, void *clo_)
+{
+/* parse gperf input in BUF, keywords are unescaped and moved to the
+ * beginning of the keyword section back to back, so they form the
+ * key vector's pool in place, struct fields are copied out */
+	const struct gperf_clo_s *clo = clo_;
+	const phgperf_t gp = clo->gp;
+	const uint8_t *const eob = buf + bsz;
+	enum {
+		SECT_DECL,
+		SECT_CODE,
+		SECT_KEYS,
+		SECT_DONE,
+	} sect = SECT_DECL;
+	bool structp = false;
+	gpbuf_t prol = {NULL};
+	gpbuf_t decl = {NULL};
+	gpbuf_t vtxt = {NULL};
+	size_t *voff = NULL;
+	uint32_t *off = NULL;
+	size_t n = 0U;
+	size_t lno = 0U;
+	uint8_t *w = NULL;
+	phvec_t res = NULL;
+
+	if (UNLIKELY(bsz >= UINT32_MAX)) {
+		/* offsets are 32 bits wide */
+		errno = EFBIG;
+		return NULL;
+	}
+
+	for (uint8_t *bp = buf, *ep; sect < SECT_DONE && bp < eob; bp = ep + 1U) {
+		const uint8_t *le;
+
+		if ((ep = memchr(bp, '\n', eob - bp)) == NULL) {
+			ep = buf + bsz;
+		}
+		le = ep > bp && ep[-1] == '\r' ? ep - 1U : ep;
+		lno++;
+
+		switch (sect) {
+		case SECT_DECL:
+			if (gperf_linep(bp, le, "%{")) {
+				sect = SECT_CODE;
+			} else if (gperf_linep(bp, le, "%%")) {
+				sect = SECT_KEYS;
+				w = ep + 1U;
+			} else if (*bp == '%') {
+				if (gperf_decl(clo, lno, bp, le, &structp) < 0) {
+					goto err;
+				}
+			} else if (le > bp) {
+				gpbuf_add(&decl, bp, ep - bp);
+				gpbuf_add(&decl, "\n", 1U);
+			}
+			break;
+		case SECT_CODE:
+			if (gperf_linep(bp, le, "%}")) {
+				sect = SECT_DECL;
+				break;
+			}
+			gpbuf_add(&prol, bp, ep - bp);
+			gpbuf_add(&prol, "\n", 1U);
+			break;
+		case SECT_KEYS: {
+			const uint8_t *rp;
+			uint8_t *kp = w;
+
+			if (gperf_linep(bp, le, "%%")) {
+				sect = SECT_DONE;
+				if (ep < eob) {
+					gp->epilogue = strndup(
+						(const char*)ep + 1U, eob - ep - 1U);
+				}
+				break;
+			} else if (bp == le || *bp == '#') {
+				/* empty lines and comments */
+				break;
+			}
+			if (*bp == '"') {
+				/* string with escapes, unescaped in place,
+				 * which only ever shortens it */
+				for (rp = bp + 1U; rp < le && *rp != '"';) {
+					if (*rp == '\\' && rp + 1U < le) {
+						*w++ = (uint8_t)gperf_unesc(&rp, le);
+					} else {
+						*w++ = *rp++;
+					}
+				}
+				if (rp++ >= le) {
+					gperf_error(clo->fn, lno,
+						    "unterminated string");
+					goto err;
+				}
+			} else {
+				for (rp = bp; rp < le && *rp != ',' &&
+					     *rp != ' ' && *rp != '\t'; rp++);
+				memmove(w, bp, rp - bp);
+				w += rp - bp;
+			}
+			/* the rest are struct fields */
+			for (; rp < le && (*rp == ' ' || *rp == '\t'); rp++);
+			if (rp < le && *rp != ',') {
+				gperf_error(clo->fn, lno,
+					    "junk after keyword: `%.*s'",
+					    (int)(le - rp), rp);
+				goto err;
+			}
+			if (!(n % 256U)) {
+				off = realloc(off, (n + 256U) * sizeof(*off));
+				voff = realloc(voff, (n + 256U) * sizeof(*voff));
+			}
+			voff[n] = vtxt.n;
+			if (rp < le) {
+				gpbuf_add(&vtxt, rp + 1U, le - rp - 1U);
+			}
+			gpbuf_add(&vtxt, "", 1U);
+			off[n++] = kp - buf;
+			/* terminate the key, this may overwrite the comma */
+			*w++ = '\0';
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	if (sect == SECT_CODE) {
+		gperf_error(clo->fn, lno, "unterminated %%{");
+		goto err;
+	} else if (sect == SECT_DECL) {
+		gperf_error(clo->fn, lno, "no %%%% line, this isn't gperf input");
+		goto err;
+	}
+	if (structp) {
+		if (decl.s == NULL || (gp->stag = gperf_stag(decl.s)) == NULL) {
+			gperf_error(clo->fn, lno,
+				    "%%struct-type given but no struct declared");
+			goto err;
+		}
+	}
+	gp->prologue = prol.s;
+	gp->decl = decl.s;
+	prol.s = decl.s = NULL;
+	gp->lookup = gp->lookup ?: strdup("in_word_set");
+	gp->wordlist = gp->wordlist ?: strdup("wordlist");
+	gp->slot = gp->slot ?: strdup("name");
+
+	res = malloc(sizeof(*res) + (n + 1U) * sizeof(*res->off));
+	res->n = n;
+	res->mapz = 0U;
+	res->pool = buf;
+	res->vals = NULL;
+	if (n) {
+		memcpy(res->off, off, n * sizeof(*off));
+	}
+	res->off[n] = w - buf;
+	if (structp) {
+		/* pointers first, then the text */
+		const char **v = malloc(n * sizeof(*v) + vtxt.n + 1U);
+		char *t = (char*)(v + n);
+
+		if (vtxt.n) {
+			memcpy(t, vtxt.s, vtxt.n);
+		}
+		for (size_t i = 0U; i < n; i++) {
+			v[i] = t + voff[i];
+		}
+		res->vals = v;
+	}
+
+err:
+	free(prol.s);
+	free(decl.s);
+	free(vtxt.s);
+	free(voff);
+	free(off);
+	if (res == NULL) {
+		errno = EINVAL;
+	}
+	return res;
+}
+
+
+bool
+ph_gperf_namep(const char *fn)
+{
+	size_t z;
+
+	if (fn == NULL || (z = strlen(fn)) < 6U) {
+		return false;
+	}
+	return !strcmp(fn + z - 6U, ".gperf");
+}
+
+phvec_t
+ph_read_gperf(const char *fn, phgperf_t *gp)
+{
+	struct gperf_clo_s clo = {fn, calloc(1U, sizeof(**gp))};
+	phvec_t res;
+
+	if ((res = ph_read_split(fn, gperf_split, &clo)) == NULL) {
+		ph_free_gperf(clo.gp);
+		clo.gp = NULL;
+	}
+	*gp = clo.gp;
+	return res;
+}
+
+void
+ph_free_gperf(phgperf_t gp)
+{
+	if (UNLIKELY(gp == NULL)) {
+		return;
+	}
+	free(gp->prologue);
+	free(gp->decl);
+	free(gp->stag);
+	free(gp->epilogue);
+	free(gp->lookup);
+	free(gp->wordlist);
+	free(gp->slot);
+	free(gp);
+	return;
+}
+
+/* gperf.c ends here */
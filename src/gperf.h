@@ -0,0 +1,75 @@
+/*** gperf.h -- reading gperf input files
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of phashist.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_gperf_h_
+#define INCLUDED_gperf_h_
+
+#include <stdbool.h>
+#include "keys.h"
+
+typedef struct {
+	/* code from %{ %} blocks, goes to the top of the output */
+	char *prologue;
+	/* the struct declaration, NULL if keywords are plain strings */
+	char *decl;
+	/* the declared struct's tag */
+	char *stag;
+	/* code after the second %%, goes to the end of the output */
+	char *epilogue;
+	/* %define lookup-function-name, word-array-name and slot-name */
+	char *lookup;
+	char *wordlist;
+	char *slot;
+	/* %omit-struct-type */
+	bool omit_struct;
+} *phgperf_t;
+
+
+/**
+ * Return true if FN is named like a gperf input file. */
+extern bool ph_gperf_namep(const char *fn);
+
+/**
+ * Read gperf input file FN and return its keywords, *GP is set to
+ * the declarations and code.  If keywords come with struct fields
+ * those are the payloads of the key vector. */
+extern phvec_t ph_read_gperf(const char *fn, phgperf_t *gp);
+
+/**
+ * Free resources associated with gperf declarations. */
+extern void ph_free_gperf(phgperf_t gp);
+
+#endif	/* INCLUDED_gperf_h_ */
@@ -43,68 +43,251 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
-#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "nifty.h"
 #include "keys.h"
 
-
-phvec_t
-ph_read_keys(const char *fn)
+
+static phvec_t
+ph_split_keys(uint8_t *buf, size_t bsz, void *UNUSED(clo))
 {
-	char *line = NULL;
-	size_t llen = 0U;
-	FILE *fp;
+/* turn the newline separated keys in BUF into a key vector in place,
+ * BUF must provide one more byte beyond BSZ for a final terminator,
+ * keys can contain any byte but newline */
+	const uint8_t *const eob = buf + bsz;
+	/* last line isn't terminated, use the spare byte */
+	const bool openp = bsz && eob[-1] != '\n';
+	size_t n = openp;
 	phvec_t res;
-	uint8_t *pool;
-	size_t ro = 0UL;
-	size_t zr;
 
-	if (fn == NULL) {
-		fp = stdin;
-	} else if ((fp = fopen(fn, "r")) == NULL) {
+	if (UNLIKELY(bsz >= UINT32_MAX)) {
+		/* offsets are 32 bits wide */
+		errno = EFBIG;
 		return NULL;
 	}
 
-	/* we'll return at least a phkv object here*/
-	res = malloc(sizeof(*res) + 64U * sizeof(*res->k));
-	res->n = 0U;
-	pool = malloc((zr = 256U) * sizeof(*pool));
+	/* count lines first so the index is allocated just once */
+	for (const uint8_t *bp = buf;
+	     bp < eob && (bp = memchr(bp, '\n', eob - bp)) != NULL; bp++) {
+		n++;
+	}
 
-	for (ssize_t nrd; (nrd = getline(&line, &llen, fp)) > 0; res->n++) {
-		/* store n-th position */
-		if (LIKELY(res->n) && UNLIKELY(!(res->n % 64U))) {
-			const size_t nu = res->n + 64U;
-			res = realloc(res, sizeof(*res) + nu * sizeof(*res->k));
+	res = malloc(sizeof(*res) + (n + 1U) * sizeof(*res->off));
+	res->n = n;
+	res->mapz = 0U;
+	res->pool = buf;
+	res->vals = NULL;
+	n = 0U;
+	for (uint8_t *bp = buf, *ep; bp < eob; bp = ep + 1U) {
+		if ((ep = memchr(bp, '\n', eob - bp)) == NULL) {
+			ep = buf + bsz;
 		}
-		res->k[res->n] = (void*)(uintptr_t)ro;
+		/* still terminate keys, for the benefit of debuggers */
+		*ep = '\0';
+		res->off[n++] = bp - buf;
+	}
+	res->off[n] = bsz + openp;
+	return res;
+}
 
-		/* store string in pool */
-		if (ro + nrd + 1U >= zr) {
-			while ((zr <<= 1U, ro + nrd + 1U >= zr));
-			pool = realloc(pool, zr * sizeof(*pool));
+static phvec_t
+ph_split_pairs(uint8_t *buf, size_t bsz, void *UNUSED(clo))
+{
+/* like ph_split_keys() for lines KEY<TAB>VALUE, keys are compacted in
+ * place and the values become the payloads, a line without a tab has
+ * an empty value */
+	const uint8_t *const eob = buf + bsz;
+	const bool openp = bsz && eob[-1] != '\n';
+	size_t n = openp;
+	uint8_t *w = buf;
+	phvec_t res;
+	const char **v;
+	char *t;
+
+	if (UNLIKELY(bsz >= UINT32_MAX)) {
+		/* offsets are 32 bits wide */
+		errno = EFBIG;
+		return NULL;
+	}
+
+	for (const uint8_t *bp = buf;
+	     bp < eob && (bp = memchr(bp, '\n', eob - bp)) != NULL; bp++) {
+		n++;
+	}
+
+	res = malloc(sizeof(*res) + (n + 1U) * sizeof(*res->off));
+	/* pointers first, then the text, which is no longer than BUF */
+	v = malloc(n * sizeof(*v) + bsz + 1U);
+	t = (char*)(v + n);
+	res->n = n;
+	res->mapz = 0U;
+	res->pool = buf;
+	res->vals = v;
+	n = 0U;
+	for (uint8_t *bp = buf, *ep, *tp; bp < eob; bp = ep + 1U) {
+		if ((ep = memchr(bp, '\n', eob - bp)) == NULL) {
+			ep = buf + bsz;
+		}
+		if ((tp = memchr(bp, '\t', ep - bp)) == NULL) {
+			tp = ep;
 		}
-		memcpy(pool + ro, line, nrd - 1);
-		ro += nrd - 1;
-		pool[ro++] = '\0';
-		pool[ro] = '\0';
+		v[n] = t;
+		if (tp < ep) {
+			memcpy(t, tp + 1U, ep - tp - 1U);
+			t += ep - tp - 1U;
+		}
+		*t++ = '\0';
+		/* keys only ever move towards the front */
+		memmove(w, bp, tp - bp);
+		res->off[n++] = w - buf;
+		w += tp - bp;
+		*w++ = '\0';
 	}
-	/* as a service, store one more pool value */
-	if (LIKELY(res->n) && UNLIKELY(!(res->n % 64U))) {
-		const size_t nu = res->n + 64U;
-		res = realloc(res, sizeof(*res) + nu * sizeof(*res->k));
+	res->off[n] = w - buf;
+	return res;
+}
+
+static uint8_t*
+ph_map_file(int fd, size_t fsz)
+{
+/* map FSZ bytes of FD copy-on-write so newlines can be overwritten,
+ * the mapping is backed by anonymous memory one byte beyond FSZ so
+ * the last key can be terminated even if FSZ is a multiple of the
+ * page size */
+	const size_t mapz = fsz + 1U;
+	void *map;
+
+	map = mmap(NULL, mapz, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (UNLIKELY(map == MAP_FAILED)) {
+		return NULL;
+	}
+	if (UNLIKELY(mmap(map, fsz, PROT_READ | PROT_WRITE,
+			  MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+		munmap(map, mapz);
+		return NULL;
 	}
-	res->k[res->n] = (void*)(uintptr_t)ro;
+#if defined MADV_SEQUENTIAL
+	madvise(map, fsz, MADV_SEQUENTIAL);
+#endif	/* MADV_SEQUENTIAL */
+	return map;
+}
 
-	if (line != NULL) {
-		free(line);
+static phvec_t
+ph_slurp_keys(int fd, ph_split_f split, void *clo)
+{
+/* streaming fallback for pipes and the like, read everything into a
+ * buffer that grows geometrically and split it in place */
+	size_t zr = 65536U;
+	size_t ro = 0U;
+	uint8_t *pool = malloc(zr);
+	phvec_t res;
+
+	for (ssize_t nrd; (nrd = read(fd, pool + ro, zr - ro - 1U)) != 0;) {
+		if (UNLIKELY(nrd < 0)) {
+			free(pool);
+			return NULL;
+		} else if ((ro += nrd) + 1U >= zr) {
+			pool = realloc(pool, zr *= 2U);
+		}
+	}
+	pool[ro] = '\0';
+	if (UNLIKELY((res = split(pool, ro, clo)) == NULL)) {
+		free(pool);
+	}
+	return res;
+}
+
+
+phvec_t
+ph_read_split(const char *fn, ph_split_f split, void *clo)
+{
+	struct stat st;
+	phvec_t res = NULL;
+	uint8_t *map;
+	int fd;
+
+	if (fn == NULL) {
+		fd = STDIN_FILENO;
+	} else if ((fd = open(fn, O_RDONLY)) < 0) {
+		return NULL;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		;
+	} else if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+		res = ph_slurp_keys(fd, split, clo);
+	} else if ((size_t)st.st_size >= UINT32_MAX) {
+		errno = EFBIG;
+	} else if ((map = ph_map_file(fd, st.st_size)) == NULL) {
+		res = ph_slurp_keys(fd, split, clo);
+	} else if ((res = split(map, st.st_size, clo)) == NULL) {
+		munmap(map, st.st_size + 1U);
+	} else {
+		res->mapz = st.st_size + 1U;
+	}
+
+	if (fn != NULL) {
+		close(fd);
+	}
+	return res;
+}
+
+phvec_t
+ph_read_keys(const char *fn)
+{
+	return ph_read_split(fn, ph_split_keys, NULL);
+}
+
+phvec_t
+ph_read_pairs(const char *fn)
+{
+	return ph_read_split(fn, ph_split_pairs, NULL);
+}
+
+phvec_t
+ph_make_keys(const char *const *keys, const size_t *lens, size_t n)
+{
+/* copy KEYS into a pool of their own, LENS may be NULL for strings */
+	size_t poolz = 0U;
+	uint8_t *pool;
+	phvec_t res;
+
+	for (size_t i = 0U; i < n; i++) {
+		poolz += (lens ? lens[i] : strlen(keys[i])) + 1U;
+	}
+	if (UNLIKELY(poolz >= UINT32_MAX)) {
+		/* offsets are 32 bits wide */
+		errno = EFBIG;
+		return NULL;
+	}
+	if (UNLIKELY((pool = malloc(poolz + 1U)) == NULL)) {
+		return NULL;
+	}
+	res = malloc(sizeof(*res) + (n + 1U) * sizeof(*res->off));
+	if (UNLIKELY(res == NULL)) {
+		free(pool);
+		return NULL;
 	}
-	fclose(fp);
+	res->n = n;
+	res->mapz = 0U;
+	res->pool = pool;
+	res->vals = NULL;
+	poolz = 0U;
+	for (size_t i = 0U; i < n; i++) {
+		const size_t z = lens ? lens[i] : strlen(keys[i]);
 
-	/* massage res for returning */
-	for (size_t i = 0U; i <= res->n; i++) {
-		res->k[i] = pool + (size_t)(uintptr_t)res->k[i];
+		res->off[i] = poolz;
+		memcpy(pool + poolz, keys[i], z);
+		pool[poolz += z] = '\0';
+		poolz++;
 	}
+	res->off[n] = poolz;
 	return res;
 }
 
@@ -113,9 +296,12 @@ ph_free_keys(phvec_t kv)
 {
 	if (UNLIKELY(kv == NULL)) {
 		return;
-	} else if (LIKELY(kv->k[0U] != NULL)) {
-		free(deconst(kv->k[0U]));
+	} else if (kv->mapz) {
+		munmap(deconst(kv->pool), kv->mapz);
+	} else {
+		free(deconst(kv->pool));
 	}
+	free(kv->vals);
 	free(kv);
 	return;
 }
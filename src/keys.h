@@ -44,24 +44,58 @@ typedef const uint8_t *phkey_t;
 
 typedef struct {
 	size_t n;
-	phkey_t k[];
+	/* size of the mapping behind POOL, 0 if it's malloc'd */
+	size_t mapz;
+	/* keys back to back, each followed by a terminator byte */
+	const uint8_t *pool;
+	/* payload text of each key, all in one allocation with VALS,
+	 * NULL if the keys come without */
+	const char **vals;
+	/* offsets of the keys in POOL, off[n] is one past the last
+	 * key's terminator, keys can thus contain any byte */
+	uint32_t off[];
 } *phvec_t;
 
-
+
+/**
+ * Split BSZ bytes in BUF into a key vector, BUF[BSZ] may be written.
+ * The vector's pool is BUF, keys can be rewritten in place. */
+typedef phvec_t(*ph_split_f)(uint8_t *buf, size_t bsz, void *clo);
+
 /**
  * Read strings to match from file and return a key vector. */
 extern phvec_t ph_read_keys(const char *fn);
 
+/**
+ * Read KEY<TAB>VALUE lines from file and return a key vector whose
+ * payloads are the values, empty for lines without a tab. */
+extern phvec_t ph_read_pairs(const char *fn);
+
+/**
+ * Like ph_read_keys() but split the file's contents using SPLIT,
+ * which is passed CLO. */
+extern phvec_t ph_read_split(const char *fn, ph_split_f split, void *clo);
+
+/**
+ * Return a key vector with copies of the N keys KEYS of lengths LENS,
+ * LENS can be NULL if the keys are NUL-terminated. */
+extern phvec_t ph_make_keys(const char *const *keys, const size_t *lens, size_t n);
+
 /* Free resources associated with a key vector */
 extern void ph_free_keys(phvec_t kv);
 
-
+
 /**
- * Compare two keys, much like strcmp(). */
-static inline __attribute__((pure, const)) int
-phkey_cmp(phkey_t k1, phkey_t k2)
+ * Compare key K1 of length Z1 and key K2 of length Z2,
+ * shorter keys sort first so the bytes are only compared if the
+ * lengths match. */
+static inline __attribute__((pure)) int
+phkey_cmp(phkey_t k1, size_t z1, phkey_t k2, size_t z2)
 {
-	return strcmp((const char*)k1, (const char*)k2);
+	if (z1 != z2) {
+		return z1 < z2 ? -1 : 1;
+	}
+	return memcmp(k1, k2, z1);
 }
 
 /**
@@ -69,15 +103,7 @@ phkey_cmp(phkey_t k1, phkey_t k2)
 static inline phkey_t
 phvec_key(phvec_t kv, size_t i)
 {
-	return kv->k[i];
-}
-
-/**
- * Return the I-th key in a key vector as character string. */
-static inline  const char*
-phvec_keystr(phvec_t kv, size_t i)
-{
-	return (const char*)kv->k[i];
+	return kv->pool + kv->off[i];
 }
 
 /**
@@ -85,16 +111,14 @@ phvec_keystr(phvec_t kv, size_t i)
 static inline size_t
 phvec_keylen(phvec_t kv, size_t i)
 {
-	return kv->k[i + 1U] - kv->k[i] - 1U;
+	return kv->off[i + 1U] - kv->off[i] - 1U;
 }
 
 static inline int
 phvec_keycmp(phvec_t kv, size_t i, size_t j)
 {
-	const phkey_t ki = phvec_key(kv, i);
-	const phkey_t kj = phvec_key(kv, j);
-
-	return phkey_cmp(ki, kj);
+	return phkey_cmp(phvec_key(kv, i), phvec_keylen(kv, i),
+			 phvec_key(kv, j), phvec_keylen(kv, j));
 }
 
 #endif	/* INCLUDED_keys_h_ */
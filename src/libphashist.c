@@ -0,0 +1,333 @@
+/*** libphashist.c -- perfect hash tables at runtime
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of phashist.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "nifty.h"
+#include "keys.h"
+#include "phash.h"
+#include "phfind.h"
+#include "phblob.h"
+#include "phashist.h"
+
+struct ph_table_s {
+	phalgo_t algo;
+	phash_f hf;
+	phash_t ilev;
+	/* whether slots derive from both hash words, see phtups_phash() */
+	bool hiwordp;
+	bool widep;
+	phcnt_t alog;
+	phcnt_t blog;
+	size_t alen;
+	size_t blen;
+	size_t smax;
+	size_t nkeys;
+	/* the sections of the blob, see phblob.h, all little-endian */
+	const uint32_t *tab;
+	const uint32_t *kix;
+	const uint32_t *koff;
+	const char *pool;
+	const uint32_t *voff;
+	const char *vpool;
+	/* pool sizes, offsets are checked against them upon use */
+	size_t poolz;
+	size_t vpoolz;
+	/* the blob itself, mapped if MAPZ is non-0, malloc()'d otherwise */
+	const uint8_t *blob;
+	size_t mapz;
+};
+
+
+static size_t
+ph_slot(ph_table_t t, phash_t lo, phash_t hi)
+{
+/* like phtups_slot() but for hash words, this is what the generated
+ * ph_slot_h() does */
+	phash_t a, b;
+
+	switch (t->algo) {
+	case PHALGO_CHD:
+		b = chd_bucket(lo, t->blen);
+		return chd_slot(hi, le32toh(t->tab[b]), t->smax);
+	case PHALGO_BOB:
+	default:
+		break;
+	}
+	if (t->widep) {
+		a = hi & (t->alen - 1U);
+		b = lo & (t->blen - 1U);
+	} else {
+		a = t->alog ? (lo >> t->blog) & (t->alen - 1U) : 0U;
+		b = t->blog ? lo & (t->blen - 1U) : 0U;
+	}
+	return (a ^ le32toh(t->tab[b])) & (t->smax - 1U);
+}
+
+static bool
+ph_sectp(const phblob_hdr_t *h, uint64_t off, uint64_t len)
+{
+/* return true if LEN bytes at OFF are within the blob */
+	return off >= sizeof(*h) && !(off % sizeof(uint32_t)) &&
+		off <= h->size && len <= h->size - off;
+}
+
+static bool
+ph_offp(const uint32_t *off, size_t i, size_t poolz)
+{
+/* return true if the I-th string of a pool of size POOLZ with offsets OFF
+ * is within the pool, every string is followed by a NUL so none can be
+ * empty */
+	const size_t o = le32toh(off[i]);
+	const size_t e = le32toh(off[i + 1U]);
+
+	return o < e && e <= poolz;
+}
+
+static ph_table_t
+ph_attach(const uint8_t *blob, size_t z)
+{
+/* return a table for blob BLOB of size Z, the header is checked and so
+ * are the sections, the offsets into the pools are left to lookups so
+ * opening stays cheap, slots beyond the keys count as vacant there */
+	phblob_hdr_t h;
+	ph_table_t res;
+
+	if (UNLIKELY(z < sizeof(h))) {
+		goto inval;
+	}
+	memcpy(&h, blob, sizeof(h));
+	phblob_hdr_swap(&h);
+	if (memcmp(h.magic, PHBLOB_MAGIC, sizeof(h.magic)) ||
+	    h.version != PHBLOB_VERSION ||
+	    h.hbits != sizeof(phash_t) * CHAR_BIT ||
+	    h.hash <= PHASH_UNK || h.hash >= PHASH_NFUN ||
+	    (h.algo != PHALGO_BOB && h.algo != PHALGO_CHD) ||
+	    h.size > z || !h.blen || !h.smax) {
+		goto inval;
+	} else if (!ph_sectp(&h, h.tab, h.blen * sizeof(uint32_t)) ||
+		   !ph_sectp(&h, h.kix, h.smax * sizeof(uint32_t)) ||
+		   !ph_sectp(&h, h.koff, (h.nkeys + 1ULL) * sizeof(uint32_t)) ||
+		   !ph_sectp(&h, h.pool, 0U)) {
+		goto inval;
+	} else if (h.voff && !ph_sectp(&h, h.voff,
+				      (h.nkeys + 1ULL) * sizeof(uint32_t))) {
+		goto inval;
+	} else if (h.vpool && !ph_sectp(&h, h.vpool, 0U)) {
+		goto inval;
+	} else if (!h.voff != !h.vpool) {
+		goto inval;
+	}
+
+	res = malloc(sizeof(*res));
+	res->algo = (phalgo_t)h.algo;
+	res->hf = phash_fun((phfun_t)h.hash);
+	res->ilev = salt_ilev(h.salt);
+	res->alen = h.alen;
+	res->blen = h.blen;
+	res->smax = h.smax;
+	res->nkeys = h.nkeys;
+	res->alog = xilogb(res->alen);
+	res->blog = xilogb(res->blen);
+	res->widep = res->alog + res->blog > PHASH_BITS;
+	res->hiwordp = res->algo == PHALGO_CHD || res->widep;
+	res->tab = (const uint32_t*)(blob + h.tab);
+	res->kix = (const uint32_t*)(blob + h.kix);
+	res->koff = (const uint32_t*)(blob + h.koff);
+	res->pool = (const char*)(blob + h.pool);
+	res->voff = h.voff ? (const uint32_t*)(blob + h.voff) : NULL;
+	res->vpool = h.vpool ? (const char*)(blob + h.vpool) : NULL;
+	res->poolz = h.size - h.pool;
+	res->vpoolz = h.vpool ? h.size - h.vpool : 0U;
+	res->blob = blob;
+	res->mapz = 0U;
+	return res;
+
+inval:
+	errno = EINVAL;
+	return NULL;
+}
+
+
+ph_table_t
+ph_build(const char *const *keys, const size_t *lens, size_t n,
+	 const ph_opt_t *o)
+{
+	phopt_t opt = {
+		.algo = PHALGO_BOB,
+		.hash = PHASH_WY,
+		.k = 1U,
+		.njobs = 1U,
+		.quiet = true,
+	};
+	ph_table_t res;
+	phtups_t tups;
+	phvec_t kv;
+	uint8_t *blob;
+	size_t z;
+
+	if (o == NULL) {
+		;
+	} else if (o->hash != NULL &&
+		   (opt.hash = phash_byname(o->hash)) == PHASH_UNK) {
+		goto inval;
+	} else if (o->algo == NULL || !strcmp(o->algo, "bob")) {
+		opt.algo = PHALGO_BOB;
+	} else if (!strcmp(o->algo, "chd")) {
+		opt.algo = PHALGO_CHD;
+	} else {
+		goto inval;
+	}
+	if (o != NULL && o->njobs) {
+		opt.njobs = o->njobs;
+	}
+	if (opt.algo == PHALGO_CHD && phash_salting(opt.hash) != PHSALT_MIXED) {
+		/* ph_find() refuses those */
+		goto inval;
+	}
+
+	if (UNLIKELY((kv = ph_make_keys(keys, lens, n)) == NULL)) {
+		return NULL;
+	} else if (UNLIKELY((tups = ph_find(kv, &opt)) == NULL)) {
+		ph_free_keys(kv);
+		errno = EEXIST;
+		return NULL;
+	}
+	/* tables live in blobs, whether built or mapped */
+	blob = phblob_make(tups, &z);
+	free_tups(tups);
+	ph_free_keys(kv);
+	if (UNLIKELY(blob == NULL)) {
+		return NULL;
+	} else if (UNLIKELY((res = ph_attach(blob, z)) == NULL)) {
+		free(blob);
+	}
+	return res;
+
+inval:
+	errno = EINVAL;
+	return NULL;
+}
+
+ph_table_t
+ph_open(const char *fn)
+{
+	struct stat st;
+	ph_table_t res = NULL;
+	void *map;
+	int fd;
+
+	if ((fd = open(fn, O_RDONLY)) < 0) {
+		return NULL;
+	} else if (fstat(fd, &st) < 0) {
+		;
+	} else if (UNLIKELY((size_t)st.st_size < sizeof(phblob_hdr_t))) {
+		errno = EINVAL;
+	} else if ((map = mmap(NULL, st.st_size, PROT_READ,
+			       MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		;
+	} else if ((res = ph_attach(map, st.st_size)) == NULL) {
+		munmap(map, st.st_size);
+	} else {
+		res->mapz = st.st_size;
+	}
+	close(fd);
+	return res;
+}
+
+size_t
+ph_lookup(ph_table_t t, const char *key, size_t len)
+{
+	const phkey_t k = (const uint8_t*)key;
+	phash_t lo = t->hf(k, len, t->ilev);
+	phash_t hi = t->hiwordp ? phash_hi(k, len, ~t->ilev) : 0U;
+	const size_t i = le32toh(t->kix[ph_slot(t, lo, hi)]);
+	size_t o;
+
+	if (i >= t->nkeys) {
+		/* vacant */
+		return PH_NOTFOUND;
+	}
+	/* check that it's really KEY */
+	o = le32toh(t->koff[i]);
+	if (!ph_offp(t->koff, i, t->poolz) ||
+	    le32toh(t->koff[i + 1U]) - o - 1U != len ||
+	    memcmp(t->pool + o, key, len)) {
+		return PH_NOTFOUND;
+	}
+	return i;
+}
+
+const char*
+ph_payload(ph_table_t t, size_t i)
+{
+	if (t->voff == NULL || i >= t->nkeys) {
+		return NULL;
+	} else if (!ph_offp(t->voff, i, t->vpoolz) ||
+		   t->vpool[le32toh(t->voff[i + 1U]) - 1U]) {
+		/* payloads are handed out as strings */
+		return NULL;
+	}
+	return t->vpool + le32toh(t->voff[i]);
+}
+
+void
+ph_free(ph_table_t t)
+{
+	if (UNLIKELY(t == NULL)) {
+		return;
+	} else if (t->mapz) {
+		munmap(deconst(t->blob), t->mapz);
+	} else {
+		free(deconst(t->blob));
+	}
+	free(t);
+	return;
+}
+
+/* libphashist.c ends here */
@@ -37,17 +37,76 @@
 #if defined HAVE_CONFIG_H
 # include "config.h"
 #endif	/* HAVE_CONFIG_H */
+#include <string.h>
+#if defined HAVE_X86INTRIN_H
+# include <x86intrin.h>
+#endif	/* HAVE_X86INTRIN_H */
 #include "phash.h"
+#include "nifty.h"
+
+/* byte-at-a-time routines are split into _ini(), _step() per byte and
+ * _fin() so the batch versions can run several keys in lockstep */
+static inline phash_t
+bingo_ini(phash_t prev)
+{
+	return prev;
+}
+
+static inline phash_t
+bingo_step(phash_t v, uint8_t c)
+{
+	v *= 33U;
+	v ^= c;
+	return v;
+}
+
+static inline phash_t
+bingo_fin(phash_t v)
+{
+	return v;
+}
 
 static phash_t
 bingo(phkey_t data, size_t dlen, phash_t prev)
 {
-	phash_t v = prev;
+	phash_t v = bingo_ini(prev);
 
 	for (size_t i = 0U; i < dlen; i++) {
-		v *= 33U;
-		v ^= data[i];
+		v = bingo_step(v, data[i]);
 	}
+	return bingo_fin(v);
+}
+
+static const char bingo_csrc[] = "\
+static phash_t\n\
+phash(const uint8_t *data, size_t dlen, phash_t prev)\n\
+{\n\
+	phash_t v = prev;\n\
+\n\
+	for (size_t i = 0U; i < dlen; i++) {\n\
+		v *= 33U;\n\
+		v ^= data[i];\n\
+	}\n\
+	return v;\n\
+}\n";
+
+static inline phash_t
+murmur_ini(phash_t prev)
+{
+	return prev ?: 19780211U;
+}
+
+static inline phash_t
+murmur_step(phash_t v, uint8_t c)
+{
+	v *= 37U;
+	v += c;
+	return v;
+}
+
+static inline phash_t
+murmur_fin(phash_t v)
+{
 	return v;
 }
 
@@ -55,26 +114,46 @@ static phash_t
 murmur(phkey_t data, size_t dlen, phash_t prev)
 {
 /* tokyocabinet's hasher */
-	phash_t v = prev ?: 19780211U;
+	phash_t v = murmur_ini(prev);
 
 	for (size_t i = 0U; i < dlen; i++) {
-		v *= 37U;
-		v += data[i];
+		v = murmur_step(v, data[i]);
 	}
-	return v;
+	return murmur_fin(v);
 }
 
-static phash_t
-oat(phkey_t data, size_t dlen, phash_t prev)
+static const char murmur_csrc[] = "\
+static phash_t\n\
+phash(const uint8_t *data, size_t dlen, phash_t prev)\n\
+{\n\
+/* tokyocabinet's hasher */\n\
+	phash_t v = prev ? prev : 19780211U;\n\
+\n\
+	for (size_t i = 0U; i < dlen; i++) {\n\
+		v *= 37U;\n\
+		v += data[i];\n\
+	}\n\
+	return v;\n\
+}\n";
+
+static inline phash_t
+oat_ini(phash_t prev)
 {
-	phash_t h = prev;
+	return prev;
+}
 
-	for (size_t i = 0U; i < dlen; i++) {
-		h += data[i];
-		h += (h << 10U);
-		h ^= (h >> 6U);
-	}
+static inline phash_t
+oat_step(phash_t h, uint8_t c)
+{
+	h += c;
+	h += (h << 10U);
+	h ^= (h >> 6U);
+	return h;
+}
 
+static inline phash_t
+oat_fin(phash_t h)
+{
 	h += h << 3U;
 	h ^= h >> 11U;
 	h += h << 15U;
@@ -82,16 +161,94 @@ oat(phkey_t data, size_t dlen, phash_t prev)
 }
 
 static phash_t
-jsw(phkey_t data, size_t dlen, phash_t prev)
+oat(phkey_t data, size_t dlen, phash_t prev)
 {
-	phash_t v = prev ?: 16777551U;
+	phash_t h = oat_ini(prev);
 
 	for (size_t i = 0U; i < dlen; i++) {
-		v = (v << 1U | v >> 31U) ^ data[i];
+		h = oat_step(h, data[i]);
 	}
+	return oat_fin(h);
+}
+
+static const char oat_csrc[] = "\
+static phash_t\n\
+phash(const uint8_t *data, size_t dlen, phash_t prev)\n\
+{\n\
+	phash_t h = prev;\n\
+\n\
+	for (size_t i = 0U; i < dlen; i++) {\n\
+		h += data[i];\n\
+		h += (h << 10U);\n\
+		h ^= (h >> 6U);\n\
+	}\n\
+\n\
+	h += h << 3U;\n\
+	h ^= h >> 11U;\n\
+	h += h << 15U;\n\
+	return h;\n\
+}\n";
+
+static inline phash_t
+jsw_ini(phash_t prev)
+{
+	return prev ?: 16777551U;
+}
+
+static inline phash_t
+jsw_step(phash_t v, uint8_t c)
+{
+	return (v << 1U | v >> 31U) ^ c;
+}
+
+static inline phash_t
+jsw_fin(phash_t v)
+{
 	return v;
 }
 
+static phash_t
+jsw(phkey_t data, size_t dlen, phash_t prev)
+{
+	phash_t v = jsw_ini(prev);
+
+	for (size_t i = 0U; i < dlen; i++) {
+		v = jsw_step(v, data[i]);
+	}
+	return jsw_fin(v);
+}
+
+static const char jsw_csrc[] = "\
+static phash_t\n\
+phash(const uint8_t *data, size_t dlen, phash_t prev)\n\
+{\n\
+	phash_t v = prev ? prev : 16777551U;\n\
+\n\
+	for (size_t i = 0U; i < dlen; i++) {\n\
+		v = (v << 1U | v >> 31U) ^ data[i];\n\
+	}\n\
+	return v;\n\
+}\n";
+
+/* icke2 shifts l and h once per word or byte, so anything but the
+ * last ICKE2_STEPS words or bytes is shifted out of l and h entirely,
+ * return the first word that can still make a difference */
+#define ICKE2_STEPS	(sizeof(phash_t) * 8U - 1U)
+#define icke2_w0(dlen)							\
+	((dlen) / 4U + (dlen) % 4U > ICKE2_STEPS			\
+	 ? (dlen) / 4U + (dlen) % 4U - ICKE2_STEPS : 0U)
+
+static inline phash_t
+icke2_fin(phash_t l, phash_t h, phash_t prev)
+{
+	/* now we've got the lowest 2 bits in l, the highest 6 bits in h */
+	l ^= (l << 5U);
+	l ^= (l >> 23U);
+	h ^= (h << 11U);
+	h ^= (h >> 19U);
+	return prev ^ l ^ h;
+}
+
 static phash_t
 icke2(phkey_t data, const size_t dlen, phash_t prev)
 {
@@ -99,7 +256,8 @@ icke2(phkey_t data, const size_t dlen, phash_t prev)
 	register phash_t l = 0U;
 	register phash_t h = 0U;
 
-	for (size_t i = 0U; i < dlen / 4U; i++, l <<= 1U, h >>= 1U) {
+	for (size_t i = icke2_w0(dlen); i < dlen / 4U;
+	     i++, l <<= 1U, h >>= 1U) {
 		register const phash_t _4 = ((const uint32_t*)data)[i];
 
 		/* lowest bits */
@@ -111,14 +269,106 @@ icke2(phkey_t data, const size_t dlen, phash_t prev)
 		l ^= data[i] & 0x07U;
 		h ^= data[i] & 0xf8U;
 	}
+	return icke2_fin(l, h, prev);
+}
 
-	/* now we've got the lowest 2 bits in l, the highest 6 bits in h */
-	l ^= (l << 5U);
-	l ^= (l >> 23U);
-	h ^= (h << 11U);
-	h ^= (h >> 19U);
-	return prev ^ l ^ h;
+#if defined HAVE_X86INTRIN_H && defined __x86_64__ && defined __GNUC__
+# define HAVE_ICKE2_AVX2
+static __attribute__((target("avx2"))) phash_t
+icke2_avx2_kern(phkey_t data, const size_t dlen, phash_t prev)
+{
+/* same as icke2() but instead of shifting l and h after every word,
+ * shift each word by the number of words and bytes that follow it,
+ * 4 words at a time, and fold the lanes afterwards */
+	const size_t nw = dlen / 4U;
+	const size_t ns = nw + dlen % 4U;
+	const __m256i ml = _mm256_set1_epi64x(0x07070707U);
+	const __m256i mh = _mm256_set1_epi64x(0xf8f8f8f8U);
+	__m256i vl = _mm256_setzero_si256();
+	__m256i vh = _mm256_setzero_si256();
+	__m256i vs;
+	size_t i = icke2_w0(dlen);
+	phash_t l, h;
+
+	/* shift counts of words i, i + 1, i + 2, i + 3 */
+	vs = _mm256_sub_epi64(_mm256_set1_epi64x(ns - i),
+			      _mm256_set_epi64x(3, 2, 1, 0));
+	for (; i + 4U <= nw; i += 4U) {
+		const __m128i _4 = _mm_loadu_si128((const void*)(data + 4U * i));
+		const __m256i w = _mm256_cvtepu32_epi64(_4);
+
+		vl = _mm256_xor_si256(vl, _mm256_sllv_epi64(
+					      _mm256_and_si256(w, ml), vs));
+		vh = _mm256_xor_si256(vh, _mm256_srlv_epi64(
+					      _mm256_and_si256(w, mh), vs));
+		vs = _mm256_sub_epi64(vs, _mm256_set1_epi64x(4));
+	}
+	with (__m128i x) {
+		x = _mm_xor_si128(_mm256_castsi256_si128(vl),
+				  _mm256_extracti128_si256(vl, 1));
+		l = _mm_cvtsi128_si64(x) ^ _mm_extract_epi64(x, 1);
+		x = _mm_xor_si128(_mm256_castsi256_si128(vh),
+				  _mm256_extracti128_si256(vh, 1));
+		h = _mm_cvtsi128_si64(x) ^ _mm_extract_epi64(x, 1);
+	}
+	/* the remaining words and bytes */
+	for (; i < nw; i++) {
+		const phash_t _4 = ((const uint32_t*)data)[i];
+
+		l ^= (_4 & 0x07070707U) << (ns - i);
+		h ^= (_4 & 0xf8f8f8f8U) >> (ns - i);
+	}
+	for (size_t j = nw * 4U; j < dlen; j++) {
+		l ^= (phash_t)(data[j] & 0x07U) << (dlen - j);
+		h ^= (phash_t)(data[j] & 0xf8U) >> (dlen - j);
+	}
+	return icke2_fin(l, h, prev);
+}
+
+static phash_t
+icke2_avx2(phkey_t data, const size_t dlen, phash_t prev)
+{
+	if (dlen < 32U) {
+		/* not worth setting up the vectors */
+		return icke2(data, dlen, prev);
+	}
+	return icke2_avx2_kern(data, dlen, prev);
 }
+#endif	/* x86_64 */
+
+static const char icke2_csrc[] = "\
+static phash_t\n\
+phash(const uint8_t *data, size_t dlen, phash_t prev)\n\
+{\n\
+/* form lower bits from lower bits, and higher bits from higher bits */\n\
+	register phash_t l = 0U;\n\
+	register phash_t h = 0U;\n\
+	/* words more than sizeof(phash_t) * 8 - 1 steps from the end\n\
+	 * are shifted out of l and h anyway */\n\
+	register size_t n = dlen / 4U + dlen % 4U;\n\
+	register size_t i = n > sizeof(phash_t) * 8U - 1U\n\
+		? n - (sizeof(phash_t) * 8U - 1U) : 0U;\n\
+\n\
+	for (; i < dlen / 4U; i++, l <<= 1U, h >>= 1U) {\n\
+		register const phash_t _4 = ((const uint32_t*)data)[i];\n\
+\n\
+		/* lowest bits */\n\
+		l ^= _4 & 0x07070707U;\n\
+		/* higher bits */\n\
+		h ^= _4 & 0xf8f8f8f8U;\n\
+	}\n\
+	for (size_t i = ((dlen / 4U) * 4U); i < dlen; i++, l <<= 1U, h >>= 1U) {\n\
+		l ^= data[i] & 0x07U;\n\
+		h ^= data[i] & 0xf8U;\n\
+	}\n\
+\n\
+	/* now we've got the lowest 2 bits in l, the highest 6 bits in h */\n\
+	l ^= (l << 5U);\n\
+	l ^= (l >> 23U);\n\
+	h ^= (h << 11U);\n\
+	h ^= (h >> 19U);\n\
+	return prev ^ l ^ h;\n\
+}\n";
 
 static phash_t
 bob(phkey_t data, size_t dlen, phash_t prev)
@@ -222,9 +472,768 @@ mix() was built out of 36 single-cycle latency instructions in a
 	return c;
 }
 
-
+static const char bob_csrc[] = "\
+static phash_t\n\
+phash(const uint8_t *data, size_t dlen, phash_t prev)\n\
+{\n\
+#define ph_mix(a, b, c)					\\\n\
+	do {						\\\n\
+		a -= b, a -= c, a ^= (c >> 13U);	\\\n\
+		b -= c, b -= a, b ^= (a << 8U);		\\\n\
+		c -= a, c -= b, c ^= (b >> 13U);	\\\n\
+		a -= b, a -= c, a ^= (c >> 12U);	\\\n\
+		b -= c, b -= a, b ^= (a << 16U);	\\\n\
+		c -= a, c -= b, c ^= (b >> 5U);		\\\n\
+		a -= b, a -= c, a ^= (c >> 3U);		\\\n\
+		b -= c, b -= a, b ^= (a << 10U);	\\\n\
+		c -= a, c -= b, c ^= (b >> 15U);	\\\n\
+	} while (0)\n\
+\n\
+	register phash_t a = 0x9e3779b9;\n\
+	register phash_t b = 0x9e3779b9;\n\
+	register phash_t c = prev;\n\
+\n\
+	/* handle most of the key */\n\
+	for (; dlen >= 12U; data += 12U, dlen -= 12U) {\n\
+		a += data[0U] +\n\
+			((phash_t)data[1U] << 8U) +\n\
+			((phash_t)data[2U] << 16U) +\n\
+			((phash_t)data[3U] << 24U);\n\
+		b += data[4U] +\n\
+			((phash_t)data[5U] << 8U) +\n\
+			((phash_t)data[6U] << 16U) +\n\
+			((phash_t)data[7U] << 24);\n\
+		c += data[8U] +\n\
+			((phash_t)data[9U] << 8U) +\n\
+			((phash_t)data[10U] << 16U) +\n\
+			((phash_t)data[11U] << 24U);\n\
+		ph_mix(a, b, c);\n\
+	}\n\
+\n\
+	/* handle the last 11 bytes */\n\
+	c += dlen;\n\
+	switch (dlen) {\n\
+	case 11U:\n\
+		c += ((phash_t)data[10U] << 24U);\n\
+		/* fallthrough */\n\
+	case 10U:\n\
+		c += ((phash_t)data[9U] << 16U);\n\
+		/* fallthrough */\n\
+	case 9U:\n\
+		c += ((phash_t)data[8U] << 8U);\n\
+		/* the first byte of c is reserved for the length */\n\
+		/* fallthrough */\n\
+	case 8U:\n\
+		b += ((phash_t)data[7U] << 24U);\n\
+		/* fallthrough */\n\
+	case 7U:\n\
+		b += ((phash_t)data[6U] << 16U);\n\
+		/* fallthrough */\n\
+	case 6U:\n\
+		b += ((phash_t)data[5U] << 8U);\n\
+		/* fallthrough */\n\
+	case 5U:\n\
+		b += data[4U];\n\
+		/* fallthrough */\n\
+	case 4U:\n\
+		a += ((phash_t)data[3U] << 24U);\n\
+		/* fallthrough */\n\
+	case 3U:\n\
+		a += ((phash_t)data[2U] << 16U);\n\
+		/* fallthrough */\n\
+	case 2U:\n\
+		a += ((phash_t)data[1U] << 8U);\n\
+		/* fallthrough */\n\
+	case 1U:\n\
+		a += data[0U];\n\
+		/* fallthrough */\n\
+	case 0U:\n\
+	default:\n\
+		break;\n\
+	}\n\
+	ph_mix(a, b, c);\n\
+#undef ph_mix\n\
+	/* report the result */\n\
+	return c;\n\
+}\n";
+
+/* crc32c, in hardware where available */
+static uint32_t crc32c_tab[256U];
+
+static void
+crc32c_init(void)
+{
+	for (uint32_t i = 0U; i < 256U; i++) {
+		uint32_t c = i;
+
+		for (unsigned int j = 0U; j < 8U; j++) {
+			c = (c >> 1U) ^ (0x82f63b78U & -(c & 1U));
+		}
+		crc32c_tab[i] = c;
+	}
+	return;
+}
+
+static inline uint32_t
+crc32c_u64(uint32_t c, uint64_t w)
+{
+	for (unsigned int j = 0U; j < 8U; j++, w >>= 8U) {
+		c = crc32c_tab[(c ^ w) & 0xffU] ^ (c >> 8U);
+	}
+	return c;
+}
+
+static inline __attribute__((always_inline)) phash_t
+crc32c_gen(phkey_t data, size_t dlen, phash_t prev,
+	   uint32_t(*crc)(uint32_t, uint64_t))
+{
+/* crc32c of DATA in 8 byte words, each offset by PREV so collisions
+ * depend on the salt, crc32c being linear otherwise, finalised with
+ * murmur3's fmix */
+	const uint64_t s = prev;
+	uint32_t c = (uint32_t)(s >> 32U) ^ (uint32_t)dlen;
+	uint64_t w;
+	size_t i;
+
+	for (i = 0U; i + 8U <= dlen; i += 8U) {
+		memcpy(&w, data + i, sizeof(w));
+		c = crc(c, w + s);
+	}
+	if (i < dlen) {
+		w = 0U;
+		memcpy(&w, data + i, dlen - i);
+		c = crc(c, w + s);
+	}
+	c ^= c >> 16U;
+	c *= 0x85ebca6bU;
+	c ^= c >> 13U;
+	c *= 0xc2b2ae35U;
+	c ^= c >> 16U;
+	return c;
+}
+
+static phash_t
+crc32c(phkey_t data, size_t dlen, phash_t prev)
+{
+	return crc32c_gen(data, dlen, prev, crc32c_u64);
+}
+
+#if defined HAVE_X86INTRIN_H && defined __x86_64__ && defined __GNUC__
+# define HAVE_CRC32C_SSE42
+static inline __attribute__((target("sse4.2"))) uint32_t
+crc32c_u64_sse42(uint32_t c, uint64_t w)
+{
+	return (uint32_t)_mm_crc32_u64(c, w);
+}
+
+static __attribute__((target("sse4.2"))) phash_t
+crc32c_sse42(phkey_t data, size_t dlen, phash_t prev)
+{
+	return crc32c_gen(data, dlen, prev, crc32c_u64_sse42);
+}
+#endif	/* x86_64 */
+
+static const char crc32c_csrc[] = "\
+#if defined __SSE4_2__ && defined __x86_64__\n\
+# include <nmmintrin.h>\n\
+# define ph_crc32c(c, w)	((uint32_t)_mm_crc32_u64(c, w))\n\
+#else  /* !__SSE4_2__ */\n\
+static uint32_t\n\
+ph_crc32c(uint32_t c, uint64_t w)\n\
+{\n\
+/* crc32c of the 8 bytes of W, least significant first */\n\
+	c ^= (uint32_t)w;\n\
+	for (unsigned int i = 0U; i < 64U; i++) {\n\
+		if (i == 32U) {\n\
+			c ^= (uint32_t)(w >> 32U);\n\
+		}\n\
+		c = (c >> 1U) ^ (0x82f63b78U & -(c & 1U));\n\
+	}\n\
+	return c;\n\
+}\n\
+#endif	/* __SSE4_2__ */\n\
+\n\
+static phash_t\n\
+phash(const uint8_t *data, size_t dlen, phash_t prev)\n\
+{\n\
+	const uint64_t s = prev;\n\
+	uint32_t c = (uint32_t)(s >> 32U) ^ (uint32_t)dlen;\n\
+	uint64_t w;\n\
+	size_t i;\n\
+\n\
+	for (i = 0U; i + 8U <= dlen; i += 8U) {\n\
+		memcpy(&w, data + i, sizeof(w));\n\
+		c = ph_crc32c(c, w + s);\n\
+	}\n\
+	if (i < dlen) {\n\
+		w = 0U;\n\
+		memcpy(&w, data + i, dlen - i);\n\
+		c = ph_crc32c(c, w + s);\n\
+	}\n\
+	c ^= c >> 16U;\n\
+	c *= 0x85ebca6bU;\n\
+	c ^= c >> 13U;\n\
+	c *= 0xc2b2ae35U;\n\
+	c ^= c >> 16U;\n\
+	return c;\n\
+}\n";
+
+/* AES rounds as mixer, in hardware where available,
+ * the initial state and the round key are digits of pi */
+#define AES_K0	(0x243f6a8885a308d3ULL)
+#define AES_K1	(0x13198a2e03707344ULL)
+#define AES_K2	(0xa4093822299f31d0ULL)
+
+static const uint8_t aes_sbox[256U] = {
+	0x63U, 0x7cU, 0x77U, 0x7bU, 0xf2U, 0x6bU, 0x6fU, 0xc5U,
+	0x30U, 0x01U, 0x67U, 0x2bU, 0xfeU, 0xd7U, 0xabU, 0x76U,
+	0xcaU, 0x82U, 0xc9U, 0x7dU, 0xfaU, 0x59U, 0x47U, 0xf0U,
+	0xadU, 0xd4U, 0xa2U, 0xafU, 0x9cU, 0xa4U, 0x72U, 0xc0U,
+	0xb7U, 0xfdU, 0x93U, 0x26U, 0x36U, 0x3fU, 0xf7U, 0xccU,
+	0x34U, 0xa5U, 0xe5U, 0xf1U, 0x71U, 0xd8U, 0x31U, 0x15U,
+	0x04U, 0xc7U, 0x23U, 0xc3U, 0x18U, 0x96U, 0x05U, 0x9aU,
+	0x07U, 0x12U, 0x80U, 0xe2U, 0xebU, 0x27U, 0xb2U, 0x75U,
+	0x09U, 0x83U, 0x2cU, 0x1aU, 0x1bU, 0x6eU, 0x5aU, 0xa0U,
+	0x52U, 0x3bU, 0xd6U, 0xb3U, 0x29U, 0xe3U, 0x2fU, 0x84U,
+	0x53U, 0xd1U, 0x00U, 0xedU, 0x20U, 0xfcU, 0xb1U, 0x5bU,
+	0x6aU, 0xcbU, 0xbeU, 0x39U, 0x4aU, 0x4cU, 0x58U, 0xcfU,
+	0xd0U, 0xefU, 0xaaU, 0xfbU, 0x43U, 0x4dU, 0x33U, 0x85U,
+	0x45U, 0xf9U, 0x02U, 0x7fU, 0x50U, 0x3cU, 0x9fU, 0xa8U,
+	0x51U, 0xa3U, 0x40U, 0x8fU, 0x92U, 0x9dU, 0x38U, 0xf5U,
+	0xbcU, 0xb6U, 0xdaU, 0x21U, 0x10U, 0xffU, 0xf3U, 0xd2U,
+	0xcdU, 0x0cU, 0x13U, 0xecU, 0x5fU, 0x97U, 0x44U, 0x17U,
+	0xc4U, 0xa7U, 0x7eU, 0x3dU, 0x64U, 0x5dU, 0x19U, 0x73U,
+	0x60U, 0x81U, 0x4fU, 0xdcU, 0x22U, 0x2aU, 0x90U, 0x88U,
+	0x46U, 0xeeU, 0xb8U, 0x14U, 0xdeU, 0x5eU, 0x0bU, 0xdbU,
+	0xe0U, 0x32U, 0x3aU, 0x0aU, 0x49U, 0x06U, 0x24U, 0x5cU,
+	0xc2U, 0xd3U, 0xacU, 0x62U, 0x91U, 0x95U, 0xe4U, 0x79U,
+	0xe7U, 0xc8U, 0x37U, 0x6dU, 0x8dU, 0xd5U, 0x4eU, 0xa9U,
+	0x6cU, 0x56U, 0xf4U, 0xeaU, 0x65U, 0x7aU, 0xaeU, 0x08U,
+	0xbaU, 0x78U, 0x25U, 0x2eU, 0x1cU, 0xa6U, 0xb4U, 0xc6U,
+	0xe8U, 0xddU, 0x74U, 0x1fU, 0x4bU, 0xbdU, 0x8bU, 0x8aU,
+	0x70U, 0x3eU, 0xb5U, 0x66U, 0x48U, 0x03U, 0xf6U, 0x0eU,
+	0x61U, 0x35U, 0x57U, 0xb9U, 0x86U, 0xc1U, 0x1dU, 0x9eU,
+	0xe1U, 0xf8U, 0x98U, 0x11U, 0x69U, 0xd9U, 0x8eU, 0x94U,
+	0x9bU, 0x1eU, 0x87U, 0xe9U, 0xceU, 0x55U, 0x28U, 0xdfU,
+	0x8cU, 0xa1U, 0x89U, 0x0dU, 0xbfU, 0xe6U, 0x42U, 0x68U,
+	0x41U, 0x99U, 0x2dU, 0x0fU, 0xb0U, 0x54U, 0xbbU, 0x16U,
+};
+
+static inline uint8_t
+aes_xt(uint8_t x)
+{
+	return (uint8_t)(x << 1U) ^ (x & 0x80U ? 0x1bU : 0x00U);
+}
+
+static void
+aes_round(uint8_t s[static 16U], const uint8_t k[static 16U])
+{
+/* what AESENC does, ShiftRows and SubBytes, MixColumns, AddRoundKey,
+ * the state is column major like in the xmm register */
+	uint8_t t[16U];
+
+	for (unsigned int i = 0U; i < 16U; i++) {
+		t[i] = aes_sbox[s[(i + 4U * (i % 4U)) % 16U]];
+	}
+	for (unsigned int c = 0U; c < 16U; c += 4U) {
+		const uint8_t a0 = t[c + 0U];
+		const uint8_t a1 = t[c + 1U];
+		const uint8_t a2 = t[c + 2U];
+		const uint8_t a3 = t[c + 3U];
+
+		s[c + 0U] = aes_xt(a0) ^ aes_xt(a1) ^ a1 ^ a2 ^ a3 ^ k[c + 0U];
+		s[c + 1U] = a0 ^ aes_xt(a1) ^ aes_xt(a2) ^ a2 ^ a3 ^ k[c + 1U];
+		s[c + 2U] = a0 ^ a1 ^ aes_xt(a2) ^ aes_xt(a3) ^ a3 ^ k[c + 2U];
+		s[c + 3U] = aes_xt(a0) ^ a0 ^ a1 ^ a2 ^ aes_xt(a3) ^ k[c + 3U];
+	}
+	return;
+}
+
+static phash_t
+aes(phkey_t data, size_t dlen, phash_t prev)
+{
+/* one AES round per 16 byte block of DATA xor'd into the state,
+ * then two more rounds for the avalanche */
+	const uint64_t k[2U] = {AES_K1, AES_K2};
+	uint64_t s[2U] = {prev, dlen ^ AES_K0};
+	uint8_t sb[16U];
+	uint8_t kb[16U];
+	size_t i = 0U;
+
+	memcpy(kb, k, sizeof(kb));
+	memcpy(sb, s, sizeof(sb));
+	for (uint8_t b[16U]; i < dlen; i += 16U) {
+		const size_t z = dlen - i < 16U ? dlen - i : 16U;
+
+		memset(b, 0, sizeof(b));
+		memcpy(b, data + i, z);
+		for (unsigned int j = 0U; j < 16U; j++) {
+			sb[j] ^= b[j];
+		}
+		aes_round(sb, kb);
+	}
+	aes_round(sb, kb);
+	aes_round(sb, kb);
+	memcpy(s, sb, sizeof(s));
+	return s[0U] ^ s[1U];
+}
+
+#if defined HAVE_X86INTRIN_H && defined __x86_64__ && defined __GNUC__
+# define HAVE_AES_AESNI
+static __attribute__((target("aes,sse4.1"))) phash_t
+aes_aesni(phkey_t data, size_t dlen, phash_t prev)
+{
+	const __m128i k = _mm_set_epi64x(AES_K2, AES_K1);
+	__m128i s = _mm_set_epi64x(dlen ^ AES_K0, prev);
+	size_t i = 0U;
+
+	for (; i + 16U <= dlen; i += 16U) {
+		const __m128i b = _mm_loadu_si128((const void*)(data + i));
+
+		s = _mm_aesenc_si128(_mm_xor_si128(s, b), k);
+	}
+	if (i < dlen) {
+		uint8_t b[16U] = {0U};
+
+		memcpy(b, data + i, dlen - i);
+		s = _mm_xor_si128(s, _mm_loadu_si128((const void*)b));
+		s = _mm_aesenc_si128(s, k);
+	}
+	s = _mm_aesenc_si128(s, k);
+	s = _mm_aesenc_si128(s, k);
+	return _mm_cvtsi128_si64(s) ^ _mm_extract_epi64(s, 1);
+}
+#endif	/* x86_64 */
+
+static const char aes_csrc[] = "\
+#if defined __AES__ && defined __SSE4_1__ && defined __x86_64__\n\
+# include <smmintrin.h>\n\
+# include <wmmintrin.h>\n\
+\n\
+static phash_t\n\
+phash(const uint8_t *data, size_t dlen, phash_t prev)\n\
+{\n\
+	const __m128i k = _mm_set_epi64x(0xa4093822299f31d0ULL, 0x13198a2e03707344ULL);\n\
+	__m128i s = _mm_set_epi64x(dlen ^ 0x243f6a8885a308d3ULL, prev);\n\
+	size_t i = 0U;\n\
+\n\
+	for (; i + 16U <= dlen; i += 16U) {\n\
+		const __m128i b = _mm_loadu_si128((const void*)(data + i));\n\
+\n\
+		s = _mm_aesenc_si128(_mm_xor_si128(s, b), k);\n\
+	}\n\
+	if (i < dlen) {\n\
+		uint8_t b[16U] = {0U};\n\
+\n\
+		memcpy(b, data + i, dlen - i);\n\
+		s = _mm_xor_si128(s, _mm_loadu_si128((const void*)b));\n\
+		s = _mm_aesenc_si128(s, k);\n\
+	}\n\
+	s = _mm_aesenc_si128(s, k);\n\
+	s = _mm_aesenc_si128(s, k);\n\
+	return _mm_cvtsi128_si64(s) ^ _mm_extract_epi64(s, 1);\n\
+}\n\
+#else  /* !__AES__ */\n\
+static const uint8_t ph_aes_sbox[256U] = {\n\
+	0x63U, 0x7cU, 0x77U, 0x7bU, 0xf2U, 0x6bU, 0x6fU, 0xc5U,\n\
+	0x30U, 0x01U, 0x67U, 0x2bU, 0xfeU, 0xd7U, 0xabU, 0x76U,\n\
+	0xcaU, 0x82U, 0xc9U, 0x7dU, 0xfaU, 0x59U, 0x47U, 0xf0U,\n\
+	0xadU, 0xd4U, 0xa2U, 0xafU, 0x9cU, 0xa4U, 0x72U, 0xc0U,\n\
+	0xb7U, 0xfdU, 0x93U, 0x26U, 0x36U, 0x3fU, 0xf7U, 0xccU,\n\
+	0x34U, 0xa5U, 0xe5U, 0xf1U, 0x71U, 0xd8U, 0x31U, 0x15U,\n\
+	0x04U, 0xc7U, 0x23U, 0xc3U, 0x18U, 0x96U, 0x05U, 0x9aU,\n\
+	0x07U, 0x12U, 0x80U, 0xe2U, 0xebU, 0x27U, 0xb2U, 0x75U,\n\
+	0x09U, 0x83U, 0x2cU, 0x1aU, 0x1bU, 0x6eU, 0x5aU, 0xa0U,\n\
+	0x52U, 0x3bU, 0xd6U, 0xb3U, 0x29U, 0xe3U, 0x2fU, 0x84U,\n\
+	0x53U, 0xd1U, 0x00U, 0xedU, 0x20U, 0xfcU, 0xb1U, 0x5bU,\n\
+	0x6aU, 0xcbU, 0xbeU, 0x39U, 0x4aU, 0x4cU, 0x58U, 0xcfU,\n\
+	0xd0U, 0xefU, 0xaaU, 0xfbU, 0x43U, 0x4dU, 0x33U, 0x85U,\n\
+	0x45U, 0xf9U, 0x02U, 0x7fU, 0x50U, 0x3cU, 0x9fU, 0xa8U,\n\
+	0x51U, 0xa3U, 0x40U, 0x8fU, 0x92U, 0x9dU, 0x38U, 0xf5U,\n\
+	0xbcU, 0xb6U, 0xdaU, 0x21U, 0x10U, 0xffU, 0xf3U, 0xd2U,\n\
+	0xcdU, 0x0cU, 0x13U, 0xecU, 0x5fU, 0x97U, 0x44U, 0x17U,\n\
+	0xc4U, 0xa7U, 0x7eU, 0x3dU, 0x64U, 0x5dU, 0x19U, 0x73U,\n\
+	0x60U, 0x81U, 0x4fU, 0xdcU, 0x22U, 0x2aU, 0x90U, 0x88U,\n\
+	0x46U, 0xeeU, 0xb8U, 0x14U, 0xdeU, 0x5eU, 0x0bU, 0xdbU,\n\
+	0xe0U, 0x32U, 0x3aU, 0x0aU, 0x49U, 0x06U, 0x24U, 0x5cU,\n\
+	0xc2U, 0xd3U, 0xacU, 0x62U, 0x91U, 0x95U, 0xe4U, 0x79U,\n\
+	0xe7U, 0xc8U, 0x37U, 0x6dU, 0x8dU, 0xd5U, 0x4eU, 0xa9U,\n\
+	0x6cU, 0x56U, 0xf4U, 0xeaU, 0x65U, 0x7aU, 0xaeU, 0x08U,\n\
+	0xbaU, 0x78U, 0x25U, 0x2eU, 0x1cU, 0xa6U, 0xb4U, 0xc6U,\n\
+	0xe8U, 0xddU, 0x74U, 0x1fU, 0x4bU, 0xbdU, 0x8bU, 0x8aU,\n\
+	0x70U, 0x3eU, 0xb5U, 0x66U, 0x48U, 0x03U, 0xf6U, 0x0eU,\n\
+	0x61U, 0x35U, 0x57U, 0xb9U, 0x86U, 0xc1U, 0x1dU, 0x9eU,\n\
+	0xe1U, 0xf8U, 0x98U, 0x11U, 0x69U, 0xd9U, 0x8eU, 0x94U,\n\
+	0x9bU, 0x1eU, 0x87U, 0xe9U, 0xceU, 0x55U, 0x28U, 0xdfU,\n\
+	0x8cU, 0xa1U, 0x89U, 0x0dU, 0xbfU, 0xe6U, 0x42U, 0x68U,\n\
+	0x41U, 0x99U, 0x2dU, 0x0fU, 0xb0U, 0x54U, 0xbbU, 0x16U,\n\
+};\n\
+\n\
+static uint8_t\n\
+ph_aes_xt(uint8_t x)\n\
+{\n\
+	return (uint8_t)(x << 1U) ^ (x & 0x80U ? 0x1bU : 0x00U);\n\
+}\n\
+\n\
+static void\n\
+ph_aes_round(uint8_t s[16U], const uint8_t k[16U])\n\
+{\n\
+/* what AESENC does */\n\
+	uint8_t t[16U];\n\
+\n\
+	for (unsigned int i = 0U; i < 16U; i++) {\n\
+		t[i] = ph_aes_sbox[s[(i + 4U * (i % 4U)) % 16U]];\n\
+	}\n\
+	for (unsigned int c = 0U; c < 16U; c += 4U) {\n\
+		const uint8_t a0 = t[c + 0U];\n\
+		const uint8_t a1 = t[c + 1U];\n\
+		const uint8_t a2 = t[c + 2U];\n\
+		const uint8_t a3 = t[c + 3U];\n\
+\n\
+		s[c + 0U] = ph_aes_xt(a0) ^ ph_aes_xt(a1) ^ a1 ^ a2 ^ a3 ^ k[c + 0U];\n\
+		s[c + 1U] = a0 ^ ph_aes_xt(a1) ^ ph_aes_xt(a2) ^ a2 ^ a3 ^ k[c + 1U];\n\
+		s[c + 2U] = a0 ^ a1 ^ ph_aes_xt(a2) ^ ph_aes_xt(a3) ^ a3 ^ k[c + 2U];\n\
+		s[c + 3U] = ph_aes_xt(a0) ^ a0 ^ a1 ^ a2 ^ ph_aes_xt(a3) ^ k[c + 3U];\n\
+	}\n\
+}\n\
+\n\
+static phash_t\n\
+phash(const uint8_t *data, size_t dlen, phash_t prev)\n\
+{\n\
+	const uint64_t k[2U] = {0x13198a2e03707344ULL, 0xa4093822299f31d0ULL};\n\
+	uint64_t s[2U] = {prev, dlen ^ 0x243f6a8885a308d3ULL};\n\
+	uint8_t sb[16U];\n\
+	uint8_t kb[16U];\n\
+	uint8_t b[16U];\n\
+\n\
+	memcpy(kb, k, sizeof(kb));\n\
+	memcpy(sb, s, sizeof(sb));\n\
+	for (size_t i = 0U; i < dlen; i += 16U) {\n\
+		const size_t z = dlen - i < 16U ? dlen - i : 16U;\n\
+\n\
+		memset(b, 0, sizeof(b));\n\
+		memcpy(b, data + i, z);\n\
+		for (unsigned int j = 0U; j < 16U; j++) {\n\
+			sb[j] ^= b[j];\n\
+		}\n\
+		ph_aes_round(sb, kb);\n\
+	}\n\
+	ph_aes_round(sb, kb);\n\
+	ph_aes_round(sb, kb);\n\
+	memcpy(s, sb, sizeof(s));\n\
+	return s[0U] ^ s[1U];\n\
+}\n\
+#endif	/* __AES__ */\n";
+
+/* wyhash-style multiply-mix, 16 to 48 bytes per step */
+#define WY_P0	(0xa0761d6478bd642fULL)
+#define WY_P1	(0xe7037ed1a0b428dbULL)
+#define WY_P2	(0x8ebc6af09c88c6e3ULL)
+#define WY_P3	(0x589965cc75374cc3ULL)
+
+static inline uint64_t
+wy_mix(uint64_t a, uint64_t b)
+{
+/* xor of the high and low word of the 128 bit product */
+#if defined __SIZEOF_INT128__
+	const unsigned __int128 r = (unsigned __int128)a * b;
+
+	return (uint64_t)r ^ (uint64_t)(r >> 64U);
+#else  /* !__SIZEOF_INT128__ */
+	const uint64_t ah = a >> 32U, al = (uint32_t)a;
+	const uint64_t bh = b >> 32U, bl = (uint32_t)b;
+	const uint64_t hh = ah * bh, hl = ah * bl, lh = al * bh, ll = al * bl;
+	const uint64_t t = hl + (ll >> 32U);
+	const uint64_t u = lh + (uint32_t)t;
+
+	return ((ll & 0xffffffffU) | u << 32U) ^ (hh + (t >> 32U) + (u >> 32U));
+#endif	/* __SIZEOF_INT128__ */
+}
+
+static inline uint64_t
+wy_r8(phkey_t p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t
+wy_r4(phkey_t p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static phash_t
+wy(phkey_t data, size_t dlen, phash_t prev)
+{
+	uint64_t seed = wy_mix(prev ^ WY_P0, WY_P1);
+	uint64_t a, b;
+
+	if (LIKELY(dlen <= 16U)) {
+		if (dlen >= 4U) {
+			/* two overlapping 4 byte reads at either end */
+			const size_t o = (dlen >> 3U) << 2U;
+
+			a = wy_r4(data) << 32U | wy_r4(data + o);
+			b = wy_r4(data + dlen - 4U) << 32U |
+				wy_r4(data + dlen - 4U - o);
+		} else if (dlen) {
+			a = (uint64_t)data[0U] << 16U |
+				(uint64_t)data[dlen >> 1U] << 8U |
+				data[dlen - 1U];
+			b = 0U;
+		} else {
+			a = b = 0U;
+		}
+	} else {
+		phkey_t p = data;
+		size_t i = dlen;
+
+		if (UNLIKELY(i > 48U)) {
+			/* three independent lanes */
+			uint64_t s1 = seed, s2 = seed;
+
+			do {
+				seed = wy_mix(wy_r8(p) ^ WY_P1,
+					      wy_r8(p + 8U) ^ seed);
+				s1 = wy_mix(wy_r8(p + 16U) ^ WY_P2,
+					    wy_r8(p + 24U) ^ s1);
+				s2 = wy_mix(wy_r8(p + 32U) ^ WY_P3,
+					    wy_r8(p + 40U) ^ s2);
+				p += 48U, i -= 48U;
+			} while (i > 48U);
+			seed ^= s1 ^ s2;
+		}
+		for (; i > 16U; p += 16U, i -= 16U) {
+			seed = wy_mix(wy_r8(p) ^ WY_P1, wy_r8(p + 8U) ^ seed);
+		}
+		/* last 16 bytes, overlapping what's been done */
+		a = wy_r8(p + i - 16U);
+		b = wy_r8(p + i - 8U);
+	}
+	a ^= WY_P1;
+	b ^= seed;
+#if defined __SIZEOF_INT128__
+	with (const unsigned __int128 r = (unsigned __int128)a * b) {
+		a = (uint64_t)r;
+		b = (uint64_t)(r >> 64U);
+	}
+#else  /* !__SIZEOF_INT128__ */
+	with (uint64_t lo = a * b) {
+		b = wy_mix(a, b) ^ lo;
+		a = lo;
+	}
+#endif	/* __SIZEOF_INT128__ */
+	return wy_mix(a ^ WY_P0 ^ dlen, b ^ WY_P1);
+}
+
+#define WY_CSRC "\
+static uint64_t\n\
+ph_wy_mix(uint64_t a, uint64_t b)\n\
+{\n\
+#if defined __SIZEOF_INT128__\n\
+	const unsigned __int128 r = (unsigned __int128)a * b;\n\
+\n\
+	return (uint64_t)r ^ (uint64_t)(r >> 64U);\n\
+#else  /* !__SIZEOF_INT128__ */\n\
+	const uint64_t ah = a >> 32U, al = (uint32_t)a;\n\
+	const uint64_t bh = b >> 32U, bl = (uint32_t)b;\n\
+	const uint64_t hh = ah * bh, hl = ah * bl, lh = al * bh, ll = al * bl;\n\
+	const uint64_t t = hl + (ll >> 32U);\n\
+	const uint64_t u = lh + (uint32_t)t;\n\
+\n\
+	return ((ll & 0xffffffffU) | u << 32U) ^ (hh + (t >> 32U) + (u >> 32U));\n\
+#endif	/* __SIZEOF_INT128__ */\n\
+}\n\
+\n\
+static uint64_t\n\
+ph_wy_r8(const uint8_t *p)\n\
+{\n\
+	uint64_t v;\n\
+	memcpy(&v, p, sizeof(v));\n\
+	return v;\n\
+}\n\
+\n\
+static uint64_t\n\
+ph_wy_r4(const uint8_t *p)\n\
+{\n\
+	uint32_t v;\n\
+	memcpy(&v, p, sizeof(v));\n\
+	return v;\n\
+}\n\
+\n\
+static phash_t\n\
+phash(const uint8_t *data, size_t dlen, phash_t prev)\n\
+{\n\
+	uint64_t seed = ph_wy_mix(prev ^ 0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL);\n\
+	uint64_t a, b;\n\
+\n\
+	if (dlen <= 16U) {\n\
+		if (dlen >= 4U) {\n\
+			const size_t o = (dlen >> 3U) << 2U;\n\
+\n\
+			a = ph_wy_r4(data) << 32U | ph_wy_r4(data + o);\n\
+			b = ph_wy_r4(data + dlen - 4U) << 32U |\n\
+				ph_wy_r4(data + dlen - 4U - o);\n\
+		} else if (dlen) {\n\
+			a = (uint64_t)data[0U] << 16U |\n\
+				(uint64_t)data[dlen >> 1U] << 8U |\n\
+				data[dlen - 1U];\n\
+			b = 0U;\n\
+		} else {\n\
+			a = b = 0U;\n\
+		}\n\
+	} else {\n\
+		const uint8_t *p = data;\n\
+		size_t i = dlen;\n\
+\n\
+		if (i > 48U) {\n\
+			uint64_t s1 = seed, s2 = seed;\n\
+\n\
+			do {\n\
+				seed = ph_wy_mix(ph_wy_r8(p) ^ 0xe7037ed1a0b428dbULL,\n\
+						 ph_wy_r8(p + 8U) ^ seed);\n\
+				s1 = ph_wy_mix(ph_wy_r8(p + 16U) ^ 0x8ebc6af09c88c6e3ULL,\n\
+					       ph_wy_r8(p + 24U) ^ s1);\n\
+				s2 = ph_wy_mix(ph_wy_r8(p + 32U) ^ 0x589965cc75374cc3ULL,\n\
+					       ph_wy_r8(p + 40U) ^ s2);\n\
+				p += 48U, i -= 48U;\n\
+			} while (i > 48U);\n\
+			seed ^= s1 ^ s2;\n\
+		}\n\
+		for (; i > 16U; p += 16U, i -= 16U) {\n\
+			seed = ph_wy_mix(ph_wy_r8(p) ^ 0xe7037ed1a0b428dbULL,\n\
+					 ph_wy_r8(p + 8U) ^ seed);\n\
+		}\n\
+		a = ph_wy_r8(p + i - 16U);\n\
+		b = ph_wy_r8(p + i - 8U);\n\
+	}\n\
+	a ^= 0xe7037ed1a0b428dbULL;\n\
+	b ^= seed;\n\
+	{\n\
+		const uint64_t lo = a * b;\n\
+\n\
+		b = ph_wy_mix(a, b) ^ lo;\n\
+		a = lo;\n\
+	}\n\
+	return ph_wy_mix(a ^ 0xa0761d6478bd642fULL ^ dlen, b ^ 0xe7037ed1a0b428dbULL);\n\
+}\n"
+
+static const char wy_csrc[] = WY_CSRC;
+
+/* the high word of phash2() in C, after phash_csrc() of any routine,
+ * WY is the name wy goes by */
+#define HI_CSRC(wy) "\n\
+static phash_t\n\
+phash_hi(const uint8_t *data, size_t dlen, phash_t prev)\n\
+{\n\
+/* 32 bits of wy, whatever the hash routine */\n\
+	return " wy "(data, dlen, prev & 0xffffffffU) & 0xffffffffU;\n\
+}\n"
+
+/* wy as ph_wy next to another routine, or as phash itself */
+static const char hi_csrc[] = "\
+#define phash	ph_wy\n" WY_CSRC "#undef phash\n" HI_CSRC("ph_wy");
+static const char hi_wy_csrc[] = HI_CSRC("phash");
+
+
+/* batch versions, each a loop around an inlined hash routine */
+#define DEFINE_BATCH(fun)						\
+static void								\
+fun##_batch(phvec_t kv, size_t from, size_t to, phash_t salt, phash_t *out) \
+{									\
+	for (size_t i = from; i < to; i++) {				\
+		*out++ = fun(phvec_key(kv, i), phvec_keylen(kv, i), salt); \
+	}								\
+	return;								\
+}
+
+/* byte-at-a-time routines have a long dependency chain per key,
+ * run 4 keys in lockstep up to the shortest key's length so the
+ * chains can overlap, then finish each key on its own */
+#define LOCKSTEP_TAIL(fun, v, k, z, m)					\
+	for (size_t j = m; j < z; j++) {				\
+		v = fun##_step(v, k[j]);				\
+	}
+#define DEFINE_BATCH_LOCKSTEP(fun)					\
+static void								\
+fun##_batch(phvec_t kv, size_t from, size_t to, phash_t salt, phash_t *out) \
+{									\
+	size_t i = from;						\
+									\
+	for (; i + 4U <= to; i += 4U, out += 4U) {			\
+		const phkey_t k0 = phvec_key(kv, i + 0U);		\
+		const phkey_t k1 = phvec_key(kv, i + 1U);		\
+		const phkey_t k2 = phvec_key(kv, i + 2U);		\
+		const phkey_t k3 = phvec_key(kv, i + 3U);		\
+		const size_t z0 = phvec_keylen(kv, i + 0U);		\
+		const size_t z1 = phvec_keylen(kv, i + 1U);		\
+		const size_t z2 = phvec_keylen(kv, i + 2U);		\
+		const size_t z3 = phvec_keylen(kv, i + 3U);		\
+		const size_t m01 = z0 < z1 ? z0 : z1;			\
+		const size_t m23 = z2 < z3 ? z2 : z3;			\
+		const size_t m = m01 < m23 ? m01 : m23;			\
+		phash_t v0 = fun##_ini(salt);				\
+		phash_t v1 = v0;					\
+		phash_t v2 = v0;					\
+		phash_t v3 = v0;					\
+									\
+		for (size_t j = 0U; j < m; j++) {			\
+			v0 = fun##_step(v0, k0[j]);			\
+			v1 = fun##_step(v1, k1[j]);			\
+			v2 = fun##_step(v2, k2[j]);			\
+			v3 = fun##_step(v3, k3[j]);			\
+		}							\
+		LOCKSTEP_TAIL(fun, v0, k0, z0, m);			\
+		LOCKSTEP_TAIL(fun, v1, k1, z1, m);			\
+		LOCKSTEP_TAIL(fun, v2, k2, z2, m);			\
+		LOCKSTEP_TAIL(fun, v3, k3, z3, m);			\
+		out[0U] = fun##_fin(v0);				\
+		out[1U] = fun##_fin(v1);				\
+		out[2U] = fun##_fin(v2);				\
+		out[3U] = fun##_fin(v3);				\
+	}								\
+	for (; i < to; i++) {						\
+		*out++ = fun(phvec_key(kv, i), phvec_keylen(kv, i), salt); \
+	}								\
+	return;								\
+}
+
+DEFINE_BATCH_LOCKSTEP(bingo)
+DEFINE_BATCH_LOCKSTEP(murmur)
+DEFINE_BATCH_LOCKSTEP(oat)
+DEFINE_BATCH_LOCKSTEP(jsw)
+DEFINE_BATCH(icke2)
+DEFINE_BATCH(bob)
+DEFINE_BATCH(crc32c)
+DEFINE_BATCH(aes)
+DEFINE_BATCH(wy)
+#if defined HAVE_CRC32C_SSE42
+DEFINE_BATCH(crc32c_sse42)
+#endif	/* HAVE_CRC32C_SSE42 */
+#if defined HAVE_AES_AESNI
+DEFINE_BATCH(aes_aesni)
+#endif	/* HAVE_AES_AESNI */
+#if defined HAVE_ICKE2_AVX2
+DEFINE_BATCH(icke2_avx2)
+#endif	/* HAVE_ICKE2_AVX2 */
+
+
 /* public API */
-static phash_t(*hf)(phkey_t, size_t, phash_t) = icke2;
+static phash_f hf = icke2;
+static phfun_t hfun = PHASH_ICKE2;
+
+static __attribute__((constructor)) void
+init_phash(void)
+{
+	crc32c_init();
+	/* upgrade to the best kernel of the default routine */
+	hf = phash_fun(hfun);
+	return;
+}
 
 phash_t
 phash(phkey_t key, size_t len, phash_t salt)
@@ -232,33 +1241,286 @@ phash(phkey_t key, size_t len, phash_t salt)
 	return hf(key, len, salt);
 }
 
+phash_t
+phash_hi(phkey_t key, size_t len, phash_t salt)
+{
+/* some of our hashes just xor the salt in or let it enter linearly,
+ * keys they hash alike collide under every salt, so the high word
+ * must not come from the same routine */
+	return wy(key, len, salt & 0xffffffffU) & 0xffffffffU;
+}
+
 void
-set_phash(phfun_t f)
+phash_hi_batch(phvec_t kv, size_t from, size_t to, phash_t salt, phash_t *out)
+{
+	for (size_t i = from; i < to; i++) {
+		*out++ = phash_hi(phvec_key(kv, i), phvec_keylen(kv, i), salt);
+	}
+	return;
+}
+
+phash2_t
+phash2(phkey_t key, size_t len, phash_t salt)
+{
+	phash2_t res;
+
+	res.lo = hf(key, len, salt);
+	res.hi = phash_hi(key, len, ~salt);
+	return res;
+}
+
+static phash_f
+icke2_best(void)
+{
+/* pick the fastest icke2 kernel the cpu supports */
+#if defined HAVE_ICKE2_AVX2
+	if (__builtin_cpu_supports("avx2")) {
+		return icke2_avx2;
+	}
+#endif	/* HAVE_ICKE2_AVX2 */
+	return icke2;
+}
+
+static phash_f
+crc32c_best(void)
+{
+#if defined HAVE_CRC32C_SSE42
+	if (__builtin_cpu_supports("sse4.2")) {
+		return crc32c_sse42;
+	}
+#endif	/* HAVE_CRC32C_SSE42 */
+	return crc32c;
+}
+
+static phash_f
+aes_best(void)
+{
+#if defined HAVE_AES_AESNI
+	if (__builtin_cpu_supports("aes") && __builtin_cpu_supports("sse4.1")) {
+		return aes_aesni;
+	}
+#endif	/* HAVE_AES_AESNI */
+	return aes;
+}
+
+phash_f
+phash_fun(phfun_t f)
 {
 	switch (f) {
 	case PHASH_OAT:
-		hf = oat;
-		break;
+		return oat;
 	case PHASH_BOB:
-		hf = bob;
-		break;
+		return bob;
 	case PHASH_JSW:
-		hf = jsw;
-		break;
+		return jsw;
 	case PHASH_BINGO:
-		hf = bingo;
-		break;
+		return bingo;
 	case PHASH_MURMUR:
-		hf = murmur;
+		return murmur;
+	case PHASH_CRC32C:
+		return crc32c_best();
+	case PHASH_AES:
+		return aes_best();
+	case PHASH_WY:
+		return wy;
+
+	case PHASH_ICKE2:
+	default:
+	case PHASH_UNK:
 		break;
+	}
+	return icke2_best();
+}
+
+phash_batch_f
+phash_batch_fun(phfun_t f)
+{
+	switch (f) {
+	case PHASH_OAT:
+		return oat_batch;
+	case PHASH_BOB:
+		return bob_batch;
+	case PHASH_JSW:
+		return jsw_batch;
+	case PHASH_BINGO:
+		return bingo_batch;
+	case PHASH_MURMUR:
+		return murmur_batch;
+	case PHASH_CRC32C:
+#if defined HAVE_CRC32C_SSE42
+		if (__builtin_cpu_supports("sse4.2")) {
+			return crc32c_sse42_batch;
+		}
+#endif	/* HAVE_CRC32C_SSE42 */
+		return crc32c_batch;
+	case PHASH_AES:
+#if defined HAVE_AES_AESNI
+		if (__builtin_cpu_supports("aes") &&
+		    __builtin_cpu_supports("sse4.1")) {
+			return aes_aesni_batch;
+		}
+#endif	/* HAVE_AES_AESNI */
+		return aes_batch;
+	case PHASH_WY:
+		return wy_batch;
 
 	case PHASH_ICKE2:
 	default:
 	case PHASH_UNK:
-		hf = icke2;
 		break;
 	}
+#if defined HAVE_ICKE2_AVX2
+	if (__builtin_cpu_supports("avx2")) {
+		return icke2_avx2_batch;
+	}
+#endif	/* HAVE_ICKE2_AVX2 */
+	return icke2_batch;
+}
+
+phash_f
+phash_kernel(phfun_t f, unsigned int i, const char **name)
+{
+	switch (i) {
+	case 0U:
+		*name = "c";
+		switch (f) {
+		case PHASH_ICKE2:
+			return icke2;
+		case PHASH_CRC32C:
+			return crc32c;
+		case PHASH_AES:
+			return aes;
+		default:
+			return phash_fun(f);
+		}
+	case 1U:
+#if defined HAVE_ICKE2_AVX2
+		if (f == PHASH_ICKE2 && __builtin_cpu_supports("avx2")) {
+			*name = "avx2";
+			return icke2_avx2;
+		}
+#endif	/* HAVE_ICKE2_AVX2 */
+#if defined HAVE_CRC32C_SSE42
+		if (f == PHASH_CRC32C && __builtin_cpu_supports("sse4.2")) {
+			*name = "sse42";
+			return crc32c_sse42;
+		}
+#endif	/* HAVE_CRC32C_SSE42 */
+#if defined HAVE_AES_AESNI
+		if (f == PHASH_AES && __builtin_cpu_supports("aes") &&
+		    __builtin_cpu_supports("sse4.1")) {
+			*name = "aesni";
+			return aes_aesni;
+		}
+#endif	/* HAVE_AES_AESNI */
+		break;
+	default:
+		break;
+	}
+	return NULL;
+}
+
+void
+set_phash(phfun_t f)
+{
+	if (f <= PHASH_UNK || f >= PHASH_NFUN) {
+		f = PHASH_ICKE2;
+	}
+	hf = phash_fun(f);
+	hfun = f;
 	return;
 }
 
+phfun_t
+get_phash(void)
+{
+	return hfun;
+}
+
+const char*
+phash_csrc(phfun_t f)
+{
+/* the sources are kept by hand next to the compiled routines,
+ * test/phfun.sh checks that both hash alike */
+	switch (f) {
+	case PHASH_OAT:
+		return oat_csrc;
+	case PHASH_BOB:
+		return bob_csrc;
+	case PHASH_JSW:
+		return jsw_csrc;
+	case PHASH_BINGO:
+		return bingo_csrc;
+	case PHASH_MURMUR:
+		return murmur_csrc;
+	case PHASH_CRC32C:
+		return crc32c_csrc;
+	case PHASH_AES:
+		return aes_csrc;
+	case PHASH_WY:
+		return wy_csrc;
+
+	case PHASH_ICKE2:
+	default:
+	case PHASH_UNK:
+		break;
+	}
+	return icke2_csrc;
+}
+
+const char*
+phash_hi_csrc(phfun_t f)
+{
+	return f == PHASH_WY ? hi_wy_csrc : hi_csrc;
+}
+
+static const char *const phash_names[PHASH_NFUN] = {
+	[PHASH_OAT] = "oat",
+	[PHASH_BINGO] = "bingo",
+	[PHASH_ICKE2] = "icke2",
+	[PHASH_JSW] = "jsw",
+	[PHASH_BOB] = "bob",
+	[PHASH_MURMUR] = "murmur",
+	[PHASH_CRC32C] = "crc32c",
+	[PHASH_AES] = "aes",
+	[PHASH_WY] = "wy",
+};
+
+phsalt_t
+phash_salting(phfun_t f)
+{
+	switch (f) {
+	case PHASH_ICKE2:
+		return PHSALT_XOR;
+	case PHASH_JSW:
+		/* rotates and xors, linear in the salt */
+	case PHASH_MURMUR:
+		/* multiplies and adds, the salt ends up as an offset */
+		return PHSALT_LINEAR;
+	default:
+		break;
+	}
+	return PHSALT_MIXED;
+}
+
+const char*
+phash_name(phfun_t f)
+{
+	if (UNLIKELY(f <= PHASH_UNK || f >= PHASH_NFUN)) {
+		return NULL;
+	}
+	return phash_names[f];
+}
+
+phfun_t
+phash_byname(const char *name)
+{
+	for (phfun_t f = PHASH_UNK + 1; f < PHASH_NFUN; f++) {
+		if (!strcmp(name, phash_names[f])) {
+			return f;
+		}
+	}
+	return PHASH_UNK;
+}
+
 /* phash.c ends here */
@@ -52,15 +52,125 @@ typedef enum {
 	PHASH_JSW,
 	PHASH_BOB,
 	PHASH_MURMUR,
+	PHASH_CRC32C,
+	PHASH_AES,
+	PHASH_WY,
+	/* number of hash routines, not a routine */
+	PHASH_NFUN,
 } phfun_t;
 
+/* hash routines */
+typedef phash_t(*phash_f)(phkey_t key, size_t len, phash_t salt);
+/* and their batch versions */
+typedef void(*phash_batch_f)(
+	phvec_t kv, size_t from, size_t to, phash_t salt, phash_t *out);
+
+/* how the salt enters a hash routine */
+typedef enum {
+	/* mixed with the key, keys collide under some salts only */
+	PHSALT_MIXED,
+	/* the salt is a function of the key's length that is xored
+	 * into or added to the hash, so if the hashes of two keys of the
+	 * same length agree in their lowest bits under one salt they do
+	 * so under every salt */
+	PHSALT_LINEAR,
+	/* like PHSALT_LINEAR but the salt is xored in as is, so this
+	 * holds for keys of any length */
+	PHSALT_XOR,
+} phsalt_t;
+
+/* hash values with two words of entropy */
+typedef struct {
+	phash_t lo;
+	phash_t hi;
+} phash2_t;
+
+/* the number of bits in a hash word that we rely on */
+#define PHASH_BITS	(32U)
+
 
 /**
  * Calculate hash of KEY of size LEN given SALT (initial/previous hash). */
 extern phash_t phash(phkey_t key, size_t len, phash_t salt);
 
+/**
+ * Calculate a two-word hash of KEY of size LEN given SALT.
+ * The low word is phash() of KEY, the high word is phash_hi() of KEY
+ * with the complement of SALT. */
+extern phash2_t phash2(phkey_t key, size_t len, phash_t salt);
+
+/**
+ * Calculate the high word of phash2() of KEY of size LEN given SALT,
+ * PHASH_BITS bits of wy whichever hash routine is in use, so keys that
+ * collide under the routine still get independent high words. */
+extern phash_t phash_hi(phkey_t key, size_t len, phash_t salt);
+
+/**
+ * Like phash_hi() for keys FROM up to but not including TO of KV. */
+extern void
+phash_hi_batch(phvec_t kv, size_t from, size_t to, phash_t salt, phash_t *out);
+
 /**
  * Globally use FUN as hash routine. */
 extern void set_phash(phfun_t fun);
 
+/**
+ * Return the hash routine currently in use. */
+extern phfun_t get_phash(void);
+
+/**
+ * Return hash routine FUN as function, independent of set_phash(). */
+extern phash_f phash_fun(phfun_t fun);
+
+/**
+ * Return the batch version of hash routine FUN, it hashes keys FROM
+ * up to but not including TO of KV with SALT into OUT, the result
+ * is the same as calling phash_fun(FUN) on each key but without
+ * the indirect call per key. */
+extern phash_batch_f phash_batch_fun(phfun_t fun);
+
+/**
+ * Return the I-th implementation of hash routine FUN that this cpu
+ * supports and its name in NAME, or NULL if there's none.
+ * All implementations compute the same hashes, the 0-th is the
+ * portable one, phash_fun() returns the fastest. */
+extern phash_f phash_kernel(phfun_t fun, unsigned int i, const char **name);
+
+/**
+ * Return how the salt enters the hashes of routine FUN. */
+extern phsalt_t phash_salting(phfun_t fun);
+
+/**
+ * Return the name of hash routine FUN as accepted by --hash. */
+extern const char *phash_name(phfun_t fun);
+
+/**
+ * Return the hash routine called NAME or PHASH_UNK if there's none. */
+extern phfun_t phash_byname(const char *name);
+
+/**
+ * Return C source code of hash routine FUN, defining
+ * static phash_t phash(const uint8_t *data, size_t dlen, phash_t prev) */
+extern const char *phash_csrc(phfun_t fun);
+
+/**
+ * Return C source code of phash_hi() to go after phash_csrc(FUN),
+ * defining static phash_t phash_hi(const uint8_t*, size_t, phash_t) */
+extern const char *phash_hi_csrc(phfun_t fun);
+
+
+/**
+ * Scramble the lower PHASH_BITS bits of X, this is murmur3's finaliser. */
+static inline phash_t
+phash_mix(phash_t x)
+{
+	x &= 0xffffffffU;
+	x ^= x >> 16U;
+	x = (x * 0x85ebca6bU) & 0xffffffffU;
+	x ^= x >> 13U;
+	x = (x * 0xc2b2ae35U) & 0xffffffffU;
+	x ^= x >> 16U;
+	return x;
+}
+
 #endif	/* INCLUDED_phash_h_ */
@@ -51,31 +51,22 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#if defined HAVE_LINUX_PERF_EVENT_H
+# include <linux/perf_event.h>
+# include <sys/syscall.h>
+#endif	/* HAVE_LINUX_PERF_EVENT_H */
+#if defined HAVE_X86INTRIN_H
+# include <x86intrin.h>
+#endif	/* HAVE_X86INTRIN_H */
 #include "nifty.h"
 #include "keys.h"
+#include "gperf.h"
 #include "phash.h"
+#include "phfind.h"
+#include "phblob.h"
 
-typedef struct {
-	size_t min;
-	size_t max;
-	phcnt_t lens[];
-} *phvec_stats_t;
-
-typedef struct {
-	phvec_t keys;
-	phash_t salt;
-	/* for k-perfect hashes */
-	phcnt_t k;
-	size_t smax;
-	size_t alen;
-	size_t blen;
-	phash_t *bmap;
-
-	struct {
-		phash_t a;
-		phash_t b;
-	} tups[];
-} *phtups_t;
+#define NIL_HASH	((phash_t)-1)
 
 
 static __attribute__((format(printf, 1, 2))) void
@@ -95,670 +86,1869 @@ error(const char *fmt, ...)
 	return;
 }
 
-static phcnt_t
-xilogb(size_t n)
+
+static int
+u64_cmp(const void *x, const void *y)
 {
-	phcnt_t i;
-	for (i = 0U; 1U << i < n; i++);
-	return i;
+	const uint_fast64_t a = *(const uint_fast64_t*)x;
+	const uint_fast64_t b = *(const uint_fast64_t*)y;
+	return (a > b) - (a < b);
 }
 
-static phash_t
-permute(phash_t x, phcnt_t nbits)
-{
-/* compute p(x), where p is a permutation of 0..(1<<nbits)-1 */
-	const phash_t msk = ((phash_t)1U << nbits) - 1U;
-	const phash_t const2 = 1U + nbits / 2U;
-	const phash_t const3 = 1U + nbits / 3U;
-	const phash_t const4 = 1U + nbits / 4U;
-	const phash_t const5 = 1U + nbits / 5U;
 
-	for (size_t i = 0U; i < 20U; i++) {
-		x = (x + (x << const2)) & msk;
-		x = (x ^ (x >> const3));
-		x = (x + (x << const4)) & msk;
-		x = (x ^ (x >> const5));
-	}
-	return x;
-}
+/* at most this many key positions */
+#define KEYPOS_MAX	(16U)
+/* key positions are at most this far into either end of a key */
+#define KEYPOS_MAXOFF	(255)
 
-static void*
-recalloc(void *x, size_t ol_nmemb, size_t nu_nmemb, size_t membz)
+static inline unsigned int
+keypos_byte(phkey_t k, size_t kz, int p)
 {
-	if (UNLIKELY((x = realloc(x, nu_nmemb * membz)) == NULL)) {
-		return NULL;
+/* return the byte at key position P of K, or 0 if K is too short */
+	if (p >= 0) {
+		return (size_t)p < kz ? k[p] : 0U;
 	}
-	memset((char*)x + ol_nmemb * membz, 0, (nu_nmemb - ol_nmemb) * membz);
-	return x;
+	return (size_t)-p <= kz ? k[kz + p] : 0U;
 }
 
-
-static __attribute__((unused)) phvec_stats_t
-phvec_stats(phvec_t kv)
+static size_t
+keypos_split(phvec_t kv, uint32_t *ord, uint8_t *grp, const size_t *act,
+	     size_t nact, int p, uint32_t *tmp)
 {
-	size_t min = -1UL, max = 0UL;
-	phvec_stats_t res;
+/* count the groups of ORD after splitting the groups starting at
+ * ACT[0..NACT-1] by the byte at key position P, if TMP is non-NULL
+ * also carry out the split, i.e. sort the groups by that byte and
+ * mark new groups in GRP */
+	size_t ngrp = 0U;
 
-	if (UNLIKELY(kv->n == 0U)) {
-		return NULL;
-	}
-	for (size_t i = 0U; i < kv->n; i++) {
-		const size_t len = phvec_keylen(kv, i);
+	for (size_t a = 0U; a < nact; a++) {
+		const size_t beg = act[a];
+		size_t end = beg + 1U;
+		size_t cnt[256U] = {0U};
 
-		if (len < min) {
-			min = len;
+		for (; !grp[end]; end++) {
+			const uint32_t i = ord[end];
+
+			cnt[keypos_byte(phvec_key(kv, i), phvec_keylen(kv, i), p)]++;
 		}
-		if (len > max) {
-			max = len;
+		with (const uint32_t i = ord[beg]) {
+			cnt[keypos_byte(phvec_key(kv, i), phvec_keylen(kv, i), p)]++;
 		}
-	}
+		if (tmp == NULL) {
+			for (size_t c = 0U; c < countof(cnt); c++) {
+				ngrp += cnt[c] > 0U;
+			}
+			continue;
+		}
+		/* counting sort into TMP and back */
+		for (size_t c = 0U, o = beg; c < countof(cnt); c++) {
+			const size_t z = cnt[c];
 
-	res = malloc(sizeof(*res) + (max - min + 1U) * sizeof(*res->lens));
-	res->min = min;
-	res->max = max;
-	memset(res->lens, 0, (max - min + 1U) * sizeof(*res->lens));
-	for (size_t i = 0U; i < kv->n; i++) {
-		const size_t kz = phvec_keylen(kv, i);
+			if (z) {
+				grp[o] = 1U;
+				ngrp++;
+			}
+			cnt[c] = o;
+			o += z;
+		}
+		for (size_t j = beg; j < end; j++) {
+			const uint32_t i = ord[j];
+			const unsigned int c = keypos_byte(
+				phvec_key(kv, i), phvec_keylen(kv, i), p);
 
-		res->lens[kz - min]++;
+			tmp[cnt[c]++] = i;
+		}
+		memcpy(ord + beg, tmp + beg, (end - beg) * sizeof(*ord));
 	}
-	return res;
+	return ngrp;
 }
 
-static __attribute__((unused)) void
-phvec_free_stats(phvec_stats_t ks)
+static phkpos_t
+phvec_keypos(phvec_t kv)
 {
-	if (UNLIKELY(ks == NULL)) {
-		return;
-	}
-	free(ks);
-	return;
-}
+/* find key positions whose bytes, together with the key length,
+ * tell all keys in KV apart, like gperf's -k
+ * keys are kept in ORD grouped by what they look like so far and
+ * the position that splits the groups most is picked greedily,
+ * return NULL if KEYPOS_MAX positions don't suffice */
+	const size_t n = kv->n;
+	uint_fast64_t *lens = malloc(n * sizeof(*lens));
+	uint32_t *ord = malloc(n * sizeof(*ord));
+	uint32_t *tmp = malloc(n * sizeof(*tmp));
+	/* GRP[j] is set if a group starts at ORD[j] */
+	uint8_t *grp = malloc(n + 1U);
+	/* the beginnings of groups with more than one key */
+	size_t *act = malloc(n * sizeof(*act));
+	phkpos_t res = malloc(sizeof(*res) + KEYPOS_MAX * sizeof(*res->pos));
+	size_t ngrp = 0U;
+	size_t maxl = 0U;
+	int noff;
+
+	/* the key length is always hashed, so group by length first */
+	for (size_t i = 0U; i < n; i++) {
+		const size_t kz = phvec_keylen(kv, i);
 
-
-static void
-guess_lengths(size_t *alen, size_t *blen, const size_t smax, const size_t nkeys)
-{
-/*
- * Find initial *alen, *blen
- * Initial alen and blen values were found empirically.  Some factors:
- *
- * If smax<256 there is no scramble, so tab[b] needs to cover 0..smax-1.
- *
- * alen and blen must be powers of 2 because the values in 0..alen-1 and
- * 0..blen-1 are produced by applying a bitmask to the initial hash function.
- *
- * alen must be less than smax, in fact less than nkeys, because otherwise
- * there would often be no i such that a^scramble[i] is in 0..nkeys-1 for
- * all the *a*s associated with a given *b*, so there would be no legal
- * value to assign to tab[b].  This only matters when we're doing a minimal
- * perfect hash.
- *
- * It takes around 800 trials to find distinct (a,b) with nkey=smax*(5/8)
- * and alen*blen = smax*smax/32.
- *
- * Values of blen less than smax/4 never work, and smax/2 always works.
- *
- * We want blen as small as possible because it is the number of bytes in
- * the huge array we must create for the perfect hash.
- *
- * When nkey <= smax*(5/8), blen=smax/4 works much more often with
- * alen=smax/8 than with alen=smax/4.  Above smax*(5/8), blen=smax/4
- * doesn't seem to care whether alen=smax/8 or alen=smax/4.  I think it
- * has something to do with 5/8 = 1/8 * 5.  For example examine 80000,
- * 85000, and 90000 keys with different values of alen.  This only matters
- * if we're doing a minimal perfect hash.
- *
- * When alen*blen <= 1<<UINT32_TBITS, the initial hash must produce one integer.
- * Bigger than that it must produce two integers, which increases the
- * cost of the hash per character hashed.
- */
-	const double dnkeys = (double)nkeys;
-	const double dsmax = (double)smax;
-
-	*alen = smax;
-	if (0) {
-		;
-	} else if (smax / 4U <= (1 << 14U)) {
-		if (0) {
-			;
-		} else if (dnkeys <= dsmax * 0.56) {
-			*blen = smax / 32U;
-		} else if (dnkeys <= dsmax * 0.74) {
-			*blen = smax / 16U;
-		} else {
-			*blen = smax / 8U;
-		}
-	} else {
-		if (0) {
-			;
-		} else if (dnkeys <= dsmax * 0.6) {
-			*blen = smax / 16U;
-		} else if (dnkeys <= dsmax * 0.8) {
-			*blen = smax / 8U;
-		} else {
-			*blen = smax / 4U;
+		lens[i] = (uint_fast64_t)kz << 32U | i;
+		if (kz > maxl) {
+			maxl = kz;
 		}
 	}
-	/* make 1 the minimum */
-	if (UNLIKELY(*alen < 1U)) {
-		*alen = 1U;
+	qsort(lens, n, sizeof(*lens), u64_cmp);
+	for (size_t j = 0U; j < n; j++) {
+		ord[j] = (uint32_t)lens[j];
+		grp[j] = !j || lens[j] >> 32U != lens[j - 1U] >> 32U;
+		ngrp += grp[j];
 	}
-	if (UNLIKELY(*blen < 1U)) {
-		*blen = 1U;
-	}
-	return;
-}
+	grp[n] = 1U;
+	free(lens);
 
-#define SCRAMBLE_LEN	(1U << 12U)
-static phash_t scramble[SCRAMBLE_LEN];
+	noff = maxl < KEYPOS_MAXOFF ? (int)maxl : KEYPOS_MAXOFF;
+	for (res->n = 0U; ngrp < n; res->n++) {
+		size_t nact = 0U;
+		size_t bestg = ngrp;
+		int best = 0;
 
-static void
-init_scramble(const size_t smax)
-{
-	/* fill scramble[] with distinct random integers in 0..smax-1 */
-	for (size_t i = 0U; i < SCRAMBLE_LEN; i++) {
-		scramble[i] = permute(i, xilogb(smax));
+		if (res->n >= KEYPOS_MAX) {
+			goto fail;
+		}
+		for (size_t j = 0U; j < n; j++) {
+			if (grp[j] && !grp[j + 1U]) {
+				act[nact++] = j;
+			}
+		}
+		/* offsets from the beginning first, then from the end */
+		for (int c = 0; c < 2 * noff; c++) {
+			const int p = c < noff ? c : noff - 1 - c;
+			const size_t g = ngrp - nact +
+				keypos_split(kv, ord, grp, act, nact, p, NULL);
+
+			if (g > bestg) {
+				bestg = g;
+				best = p;
+			}
+		}
+		if (bestg == ngrp) {
+			/* duplicates, or keys that differ too deep inside */
+			goto fail;
+		}
+		keypos_split(kv, ord, grp, act, nact, best, tmp);
+		res->pos[res->n] = best;
+		ngrp = bestg;
 	}
-	return;
-}
+	goto out;
 
-static phtups_t
-make_tups(phvec_t keys, phcnt_t k)
-{
-	phtups_t res = malloc(sizeof(*res) + keys->n * sizeof(*res->tups));
-
-	res->keys = keys;
-	/* guess initial values for smax, alen and blen */
-	res->smax = 1UL << xilogb(keys->n);
-	guess_lengths(&res->alen, &res->blen, res->smax, keys->n);
-	/* and some counters for the distribution of b-values */
-	res->bmap = malloc(res->blen * sizeof(*res->bmap));
-	/* assign k-perfection value */
-	res->k = k;
+fail:
+	free(res);
+	res = NULL;
+out:
+	free(ord);
+	free(tmp);
+	free(grp);
+	free(act);
 	return res;
 }
 
 static void
-free_tups(phtups_t ktups)
+keypos_fprint(FILE *fp, phkpos_t kp)
 {
-	free(ktups->bmap);
-	free(ktups);
-	return;
-}
-
-static int
-phtups_phash(phtups_t ktups, phash_t salt)
-{
-/* this is Bob's initnorm() routine */
-	const phcnt_t alog = xilogb(ktups->alen);
-	const phcnt_t blog = xilogb(ktups->blen);
-	const phvec_t keys = ktups->keys;
-	const phash_t ilev = salt * 0x9e3779b9U;
+/* print key positions in gperf's notation, 1-based, $ is the last byte */
+	for (size_t j = 0U; j < kp->n; j++) {
+		const int p = kp->pos[j];
 
-#define CHECKSTATE	(8U)
-	if (alog + blog > 32U/*bits*/) {
-		for (size_t i = 0U; i < keys->n; i++) {
-			/* checksum(); et al */
-			abort();
+		if (j) {
+			fputc(',', fp);
 		}
-	} else {
-		for (size_t i = 0U; i < keys->n; i++) {
-			phkey_t k = phvec_key(keys, i);
-			size_t kz = phvec_keylen(keys, i);
-			phash_t h = phash(k, kz, ilev);
-
-			ktups->tups[i].a = alog
-				? (h >> blog) & (ktups->alen - 1U) : 0U;
-			ktups->tups[i].b = blog
-				? h & (ktups->blen - 1U) : 0U;
+		if (p >= 0) {
+			fprintf(fp, "%d", p + 1);
+		} else if (p < -1) {
+			fprintf(fp, "$-%d", -p - 1);
+		} else {
+			fputc('$', fp);
 		}
 	}
-	return 0;
+	return;
 }
 
 static size_t
-phtups_mktab(phtups_t tups, bool thoroughp)
+keypos_nword(phkpos_t kp)
 {
-/* this is Bob's inittab()
- * put keys in tabb according to key->b_k
- * check if the initial hash might work,
- * return the number of collisions */
-	const phvec_t keys = tups->keys;
-	size_t ncoll = 0U;
+/* number of 64bit words the hash sees for key positions KP */
+	return (kp->n + 4U + 7U) / 8U;
+}
 
-	/* two keys with the same (a,b) guarantee a collision */
-	for (size_t i = 0U; i < keys->n; i++) {
-		phash_t bi = tups->tups[i].b;
+static phvec_t
+phvec_gather(phvec_t kv, phkpos_t kp)
+{
+/* return the keys of KV as the hash sees them, the bytes at key
+ * positions KP followed by the 4 bytes of the key length, byte J
+ * goes into bits 8 * (J % 8) of 64bit word J / 8, words are built in
+ * registers and stored whole so the generated code doesn't read back
+ * single byte stores, see ph_genc_kpos() */
+	const size_t nw = keypos_nword(kp);
+	const size_t z = nw * sizeof(uint64_t);
+	phvec_t res;
+	uint8_t *pool;
+
+	if (UNLIKELY(kv->n * (z + 1U) >= UINT32_MAX)) {
+		errno = EFBIG;
+		return NULL;
+	}
+	res = malloc(sizeof(*res) + (kv->n + 1U) * sizeof(*res->off));
+	pool = malloc(kv->n * (z + 1U));
+	res->n = kv->n;
+	res->mapz = 0U;
+	res->pool = pool;
+	res->vals = NULL;
+	for (size_t i = 0U; i < kv->n; i++, pool += z + 1U) {
+		phkey_t k = phvec_key(kv, i);
+		const size_t kz = phvec_keylen(kv, i);
+		uint64_t w[(KEYPOS_MAX + 4U + 7U) / 8U] = {0U};
 
-		/* find other keys with b-value B */
-		for (size_t j = 0U; j < keys->n; j++) {
-			phash_t bj = tups->tups[j].b;
+		for (size_t j = 0U; j < kp->n + 4U; j++) {
+			const uint64_t b = j < kp->n
+				? keypos_byte(k, kz, kp->pos[j])
+				: (kz >> (8U * (j - kp->n))) & 0xffU;
 
-			/* check a-value for identical b-values */
-			if (UNLIKELY(i == j)) {
-				continue;
-			} else if (LIKELY(bi != bj)) {
-				continue;
-			} else if (tups->tups[i].a == tups->tups[j].a) {
-				/* collision */
-				ncoll++;
-				if (!phvec_keycmp(keys, i, j)) {
-					/* grrr, we've got key dups */
-					errno = 0, error("\
-duplicate keys detected: line %zu  vs  line %zu  `%s'",
-					      i + 1U, j + 1U,
-					      phvec_key(keys, i));
-				}
-				/* here we could break because
-				 * we already know there are collisions */
-				if (!thoroughp) {
-					goto out;
-				}
-			}
+			w[j / 8U] |= b << (8U * (j % 8U));
 		}
+		memcpy(pool, w, z);
+		pool[z] = '\0';
+		res->off[i] = i * (z + 1U);
 	}
-out:
-	return ncoll;
+	res->off[kv->n] = kv->n * (z + 1U);
+	return res;
 }
 
-#define NIL_HASH	((phash_t)-1)
-
-/* find a mapping that makes this a perfect hash */
-static bool
-phtups_perfp(phtups_t tups)
-{
-/* greedy approach */
-	const size_t bmpz = tups->blen * sizeof(*tups->bmap);
-	const phvec_t keys = tups->keys;
-	phcnt_t bcnt[tups->blen];
-	phash_t bsrt[tups->blen];
-	phcnt_t nsrt = 0U;
-	phcnt_t maxb = 0U;
-	phcnt_t *xcnt;
-
-	if (UNLIKELY(tups->bmap == NULL)) {
-		tups->bmap = malloc(bmpz);
-	} else {
-		tups->bmap = realloc(tups->bmap, bmpz);
+static size_t
+uint_size(size_t max)
+{
+/* size of the smallest unsigned type that can hold values up to MAX */
+	if (max <= 0xffU) {
+		return 1U;
+	} else if (max <= 0xffffU) {
+		return 2U;
 	}
+	return 4U;
+}
 
-	/* rinse b-map */
-	memset(tups->bmap, 0, bmpz);
+static const char*
+uint_type(size_t max)
+{
+	switch (uint_size(max)) {
+	case 1U:
+		return "uint8_t";
+	case 2U:
+		return "uint16_t";
+	default:
+		break;
+	}
+	return "uint32_t";
+}
 
-	/* rinse b-counts */
-	memset(bcnt, 0, sizeof(bcnt));
+static size_t
+ph_maxkeylen(phvec_t kv)
+{
+	size_t max = 0U;
 
-	for (size_t i = 0U; i < keys->n; i++) {
-		if (++bcnt[tups->tups[i].b] > maxb) {
-			maxb = bcnt[tups->tups[i].b];
+	for (size_t i = 0U; i < kv->n; i++) {
+		if (phvec_keylen(kv, i) > max) {
+			max = phvec_keylen(kv, i);
 		}
 	}
-	/* sort the b's */
-	for (phcnt_t m = maxb; m; m--) {
-		for (size_t i = 0U; i < tups->blen; i++) {
-			if (bcnt[i] == m) {
-				bsrt[nsrt++] = i;
+	return max;
+}
+
+static void
+ph_genc_str(phkey_t k, size_t z)
+{
+/* emit key K of length Z as string literal, escaping whatever isn't
+ * printable, octal escapes are always 3 digits wide so they can't
+ * swallow digits that follow */
+	putchar('"');
+	for (size_t i = 0U; i < z; i++) {
+		switch (k[i]) {
+		case '"':
+		case '\\':
+			putchar('\\');
+			putchar(k[i]);
+			break;
+		case '?':
+			/* don't let ?? start a trigraph */
+			if (i && k[i - 1U] == '?') {
+				putchar('\\');
+			}
+			putchar('?');
+			break;
+		default:
+			if (k[i] < 0x20U || k[i] >= 0x7fU) {
+				printf("\\%03o", k[i]);
+				break;
 			}
+			putchar(k[i]);
+			break;
 		}
 	}
+	putchar('"');
+	return;
+}
 
-	/* generate the bitset (or counting set really) */
-	xcnt = malloc(tups->smax * sizeof(*xcnt));
+static void
+ph_genc_tab(phtups_t tups)
+{
+	phash_t max = 0U;
 
-retry:
-	/* rinse xcnt */
-	memset(xcnt, 0, tups->smax * sizeof(*xcnt));
-#if 0
-	for (size_t b = 0U; b < nsrt; b++) {
-		for (size_t i = 0U; i < keys->n; i++) {
-			if (tups->tups[i].b == b) {
-				phash_t h = tups->tups[i].a ^ tups->bmap[b];
-
-				h &= tups->smax - 1U;
-				if (tups->bmap[b] >= tups->smax) {
-					goto fail;
-				} else if (xcnt[h]++ >= tups->k) {
-					/* try another bmap value */
-					tups->bmap[b]++;
-					goto retry;
-				}
-			}
+	for (size_t i = 0U; i < tups->blen; i++) {
+		if (tups->bmap[i] > max) {
+			max = tups->bmap[i];
 		}
 	}
-#else
-	for (size_t i = 0U; i < keys->n; i++) {
-		const phash_t b = tups->tups[i].b;
-		phash_t h = tups->tups[i].a ^ tups->bmap[b];
-
-		h &= tups->smax - 1U;
-		if (tups->bmap[b] >= tups->smax) {
-			goto fail;
-		} else if (xcnt[h]++ >= tups->k) {
-			/* try another bmap value */
-			tups->bmap[b]++;
-			goto retry;
-		}
+	printf("static const %s tab[] = {\n", uint_type(max));
+	for (size_t i = 0U; i < tups->blen; i++) {
+		printf("0x%lxU,%c", tups->bmap[i],
+		       (i % 8U) == 7U ? '\n' : ' ');
 	}
-#endif	/* 0 */
-
+	if (tups->blen % 8U) {
+		putchar('\n');
+	}
+	puts("};\n");
+	return;
+}
 
-	memset(xcnt, 0, tups->smax * sizeof(*xcnt));
-	for (size_t i = 0U; i < keys->n; i++) {
-		phash_t h = tups->tups[i].a ^ tups->bmap[tups->tups[i].b];
+static void
+ph_genc_hash(phtups_t tups)
+{
+/* emit the hash function and, if needed, phash_hi() and phash_mix() */
+	putchar('\n');
+	puts(phash_csrc(tups->hash));
+	if (phtups_hiwordp(tups)) {
+		puts(phash_hi_csrc(tups->hash));
+	}
 
-		h &= tups->smax - 1U;
-		if (++xcnt[h] > tups->k) {
-			printf("%02zx %02zu\n", h, xcnt[h]);
-		}
+	if (phtups_hiwordp(tups) || tups->pfx != NULL) {
+		/* keep in sync with phash_mix() */
+		puts("\
+static phash_t\n\
+phash_mix(phash_t x)\n\
+{\n\
+	x &= 0xffffffffU;\n\
+	x ^= x >> 16U;\n\
+	x = (x * 0x85ebca6bU) & 0xffffffffU;\n\
+	x ^= x >> 13U;\n\
+	x = (x * 0xc2b2ae35U) & 0xffffffffU;\n\
+	x ^= x >> 16U;\n\
+	return x;\n\
+}\n");
 	}
+	return;
+}
 
-	/* PERFICK, we found a perfect hash */
-	return true;
+static void
+ph_genc_bob(phtups_t tups)
+{
+/* emit tab[] and ph_slot_h() for Bob's scheme */
+	const bool widep = phtups_widep(tups);
 
-fail:
-	errno = 0, error("\
-failed to map groups for tab size %zu", tups->blen);
-	return false;
-}
+	puts("/* small adjustments to A to make values distinct */");
+	ph_genc_tab(tups);
 
-static phtups_t
-ph_find(phvec_t keys, phcnt_t k)
-{
-/* try and find a perfect hash function
- * return the successful initializer for the initial hash.
- * return 0 if no perfect hash could be found. */
-	size_t alen_max;
-
-	/* how many times did phvec_phash() fail */
-	phcnt_t badk = 0U;
-	/* how many times did phvec_mkperf() fail */
-	phcnt_t badp;
-	phtups_t res = make_tups(keys, k);
-
-	/* more init'ting (could go into make_tups() really */
-	init_scramble(res->smax);
-	alen_max = res->smax;
-
-	/* actually find the hash now */
-	badk = 0U;
-	badp = 0U;
-	for (phash_t trysalt = 1U; ; trysalt++) {
-		/* try and find distinct tuples (a,b) for all keys */
-		phtups_phash(res, trysalt);
-
-		if (phtups_mktab(res, false) > 0U) {
-			/* there are collisions */
-#define RETRY_MKTAB	(4096U)
-			/* didn't find distinct (a,b) */
-			if (++badk < RETRY_MKTAB) {
-				/* keep on looking */
-				continue;
+	printf("static const unsigned int alog = %zuU;\n", xilogb(tups->alen));
+	printf("static const unsigned int blog = %zuU;\n", xilogb(tups->blen));
+	printf("static const unsigned int slog = %zuU;\n", xilogb(tups->smax));
 
-				/* try and put more bits in (a,b)
-				 * to make distinct (a,b) more likely */
-			} else if (res->alen < alen_max) {
-				res->alen *= 2U;
-			} else if (res->blen < res->smax) {
-				res->blen *= 2U;
-			} else {
-				/* we're fucked, count the collisions */
-				errno = 0, error("\
-fatal error: cannot find perfect hash, still %zu collisions",
-						 phtups_mktab(res, true));
-				goto fail;
-			}
-			/* reset and try with larger alen/blen */
-			badk = 0U;
-			badp = 0U;
-
-		} else if (!phtups_perfp(res)) {
-			/* no collisions, but not perfect either */
-#define RETRY_PERFP	(1U)
-			if (++badp < RETRY_PERFP) {
-				continue;
-			} else if (res->blen < res->smax) {
-				res->blen *= 2U;
-
-				/* we know this salt got us perfectly
-				 * distinct (a,b) */
-				trysalt--;
-			} else if (res->smax <= 4U * alen_max) {
-				res->smax *= 2U;
-
-				/* we know this salt got us perfectly
-				 * distinct (a,b) */
-				trysalt--;
-			} else {
-				errno = 0, error("\
-fatal error: cannot perfect hash");
-				goto fail;
-			}
-			/* reset badp counter, new salt new luck */
-			badp = 0U;
-		} else {
-			/* yay!!! we've got it */
-			res->salt = trysalt;
-			break;
-		}
-	}
-	errno = 0, error("built perfect hash table of size %zu", res->blen);
-	return res;
+	ph_genc_hash(tups);
 
-fail:
-	free_tups(res);
-	return NULL;
+	puts("\n\
+static inline size_t\n\
+ph_slot_h(phash_t lo, phash_t hi)\n\
+{");
+	if (!widep) {
+		puts("\
+	register phash_t a = (lo >> blog) & (((phash_t)1U << alog) - 1U);\n\
+	register phash_t x;\n\
+\n\
+	(void)hi;\n\
+	x = a ^ tab[lo & (((phash_t)1U << blog) - 1U)];\n\
+	return x & (((phash_t)1U << slog) - 1U);\n\
+}");
+	} else {
+		/* see phash2() */
+		puts("\
+	register phash_t a = hi & (((phash_t)1U << alog) - 1U);\n\
+	register phash_t x;\n\
+\n\
+	x = a ^ tab[lo & (((phash_t)1U << blog) - 1U)];\n\
+	return x & (((phash_t)1U << slog) - 1U);\n\
+}");
+	}
+	puts("\n\
+static inline const void*\n\
+ph_tabp(phash_t lo)\n\
+{\n\
+/* where ph_slot_h() looks into tab[], for prefetching */\n\
+	return tab + (lo & (((phash_t)1U << blog) - 1U));\n\
+}");
+	return;
 }
 
 static void
-ph_genc(phtups_t tups)
+ph_genc_chd(phtups_t tups)
 {
-	puts("#include <stdint.h>\n");
+/* emit tab[] and ph_slot_h() for CHD, see chd_bucket() and chd_slot()
+ * displacements >= CHD_DEXC are escaped in tab[] and looked up in
+ * a sorted list of exceptions */
+	const size_t nexc = chd_nexc(tups);
+
+	puts("/* displacements per bucket */");
+	printf("static const uint8_t tab[] = {\n");
+	for (size_t i = 0U; i < tups->blen; i++) {
+		phash_t d = tups->bmap[i];
+
+		printf("0x%lxU,%c", d < CHD_DEXC ? d : CHD_DEXC,
+		       (i % 8U) == 7U ? '\n' : ' ');
+	}
+	if (tups->blen % 8U) {
+		putchar('\n');
+	}
+	puts("};\n");
 
-	if (tups->blen >= SCRAMBLE_LEN) {
-		if (tups->smax > 0xffffU + 1U) {
-			puts("uint_fast32_t scramble[] = {");
-			for (size_t i = 0; i <= 0xffU; i += 4U) {
-				printf("0x%.8lx, 0x%.8lx, 0x%.8lx, 0x%.8lx,\n",
-				       scramble[i + 0U],
-				       scramble[i + 1U],
-				       scramble[i + 2U],
-				       scramble[i + 3U]);
-			}
-		} else {
-			puts("uint_fast16_t scramble[] = {");
-			for (size_t i = 0U; i <= 0xffU; i+=8) {
-				printf("\
-0x%.4lx, 0x%.4lx, 0x%.4lx, 0x%.4lx, 0x%.4lx, 0x%.4lx, 0x%.4lx, 0x%.4lx,\n",
-				       scramble[i + 0U],
-				       scramble[i + 1U],
-				       scramble[i + 2U],
-				       scramble[i + 3U],
-				       scramble[i + 4U],
-				       scramble[i + 5U],
-				       scramble[i + 6U],
-				       scramble[i + 7U]);
-			}
-		}
-		puts("};\n");
-	}
-	if (tups->blen > 0U) {
-		puts("/* small adjustments to A to make values distinct */");
-
-		if (tups->smax <= 0x100U || tups->blen >= SCRAMBLE_LEN) {
-			puts("static uint_fast8_t tab[] = {");
-		} else {
-			puts("static uint_fast16_t tab[] = {");
-		}
-
-		if (tups->blen < 16U && tups->smax > 0x100U) {
-			for (size_t i = 0U; i < tups->blen; i++) {
-				printf("0x%03lxU, ", scramble[tups->bmap[i]]);
-			}
-		} else if (tups->blen >= SCRAMBLE_LEN) {
-			for (size_t i = 0U; i < tups->blen; i += 8U) {
-				printf("\
-%lu, %lu, %lu, %lu,  %lu, %lu, %lu, %lu,\n",
-				       scramble[tups->bmap[i + 0U]],
-				       scramble[tups->bmap[i + 1U]],
-				       scramble[tups->bmap[i + 2U]],
-				       scramble[tups->bmap[i + 3U]],
-				       scramble[tups->bmap[i + 4U]],
-				       scramble[tups->bmap[i + 5U]],
-				       scramble[tups->bmap[i + 6U]],
-				       scramble[tups->bmap[i + 7U]]);
+	if (nexc) {
+		phash_t max = 0U;
+		size_t j;
+
+		puts("/* buckets with large displacements and their displacements */");
+		printf("static const %s xb[] = {\n", uint_type(tups->blen - 1U));
+		j = 0U;
+		for (size_t i = 0U; i < tups->blen; i++) {
+			if (tups->bmap[i] < CHD_DEXC) {
+				continue;
+			} else if (tups->bmap[i] > max) {
+				max = tups->bmap[i];
 			}
-		} else {
-			for (size_t i = 0U; i < tups->blen; i += 8U) {
-				printf("\
-0x%lxU, 0x%lxU, 0x%lxU, 0x%lxU,  0x%lxU, 0x%lxU, 0x%lxU, 0x%lxU,\n",
-				       tups->bmap[i + 0U],
-				       tups->bmap[i + 1U],
-				       tups->bmap[i + 2U],
-				       tups->bmap[i + 3U],
-				       tups->bmap[i + 4U],
-				       tups->bmap[i + 5U],
-				       tups->bmap[i + 6U],
-				       tups->bmap[i + 7U]);
+			printf("0x%zxU,%c", i, (j++ % 8U) == 7U ? '\n' : ' ');
+		}
+		puts("\n};");
+		printf("static const %s xd[] = {\n", uint_type(max));
+		j = 0U;
+		for (size_t i = 0U; i < tups->blen; i++) {
+			if (tups->bmap[i] < CHD_DEXC) {
+				continue;
 			}
+			printf("0x%lxU,%c", tups->bmap[i],
+			       (j++ % 8U) == 7U ? '\n' : ' ');
 		}
-		puts("};\n");
+		puts("\n};\n");
 	}
 
-	puts("typedef uint_fast32_t phash_t;");
-	printf("static const phash_t salt = 0x%zxU * 0x9e3779b9U;\n", tups->salt);
-	printf("static const unsigned int blog = %zuU;\n", xilogb(tups->blen));
-	printf("static const unsigned int slog = %zuU;\n", xilogb(tups->smax));
+	printf("static const size_t nbkt = %zuU;\n", tups->blen);
+	printf("static const size_t nslot = %zuU;\n", tups->smax);
+
+	ph_genc_hash(tups);
 
 	puts("\n\
-static phash_t\n\
-phash(const uint8_t *data, const size_t dlen, phash_t prev)\n\
+static inline phash_t\n\
+ph_disp(phash_t b)\n\
 {\n\
-/* form lower bits from lower bits, and higher bits from higher bits */\n\
-	register phash_t l = 0U;\n\
-	register phash_t h = 0U;\n\
+	register phash_t d = tab[b];\n");
+	if (nexc) {
+		printf("\
+	if (d == 0x%xU) {\n\
+		/* bisect the exceptions */\n\
+		size_t lo = 0U;\n\
+		size_t hi = %zuU;\n\
 \n\
-	for (size_t i = 0U; i < dlen / 4U; i++, l <<= 1U, h >>= 1U) {\n\
-		register const phash_t _4 = ((const uint32_t*)data)[i];\n\
+		while (lo < hi) {\n\
+			size_t mid = (lo + hi) / 2U;\n\
 \n\
-		/* lowest bits */\n\
-		l ^= _4 & 0x07070707U;\n\
-		/* higher bits */\n\
-		h ^= _4 & 0xf8f8f8f8U;\n\
-	}\n\
-	for (size_t i = ((dlen / 4U) * 4U); i < dlen; i++, l <<= 1U, h >>= 1U) {\n\
-		l ^= data[i] & 0x07U;\n\
-		h ^= data[i] & 0xf8U;\n\
-	}\n\
+			if (xb[mid] < b) {\n\
+				lo = mid + 1U;\n\
+			} else {\n\
+				hi = mid;\n\
+			}\n\
+		}\n\
+		d = xd[lo];\n\
+	}\n", CHD_DEXC, nexc);
+	}
+	puts("\
+	return d;\n\
+}\n\
 \n\
-	/* now we've got the lowest 2 bits in l, the highest 6 bits in h */\n\
-	l ^= (l << 5U);\n\
-	l ^= (l >> 23U);\n\
-	h ^= (h << 11U);\n\
-	h ^= (h >> 19U);\n\
-	return prev ^ l ^ h;\n\
-}\n");
-
-	puts("\n\
-static inline const char*\n\
-hash(const char *key, size_t len)\n\
+static inline size_t\n\
+ph_slot_h(phash_t lo, phash_t hi)\n\
+{\n\
+	register phash_t b = ((uint_fast64_t)(lo & 0xffffffffU) * nbkt) >> 32U;\n\
+	register uint_fast64_t x;\n\
+\n\
+	x = (hi + ph_disp(b) * (phash_mix(hi) | 1U)) & 0xffffffffU;\n\
+	return (x * nslot) >> 32U;\n\
+}\n\
+\n\
+static inline const void*\n\
+ph_tabp(phash_t lo)\n\
 {\n\
-	static const char *t[] = {");
+/* where ph_slot_h() looks into tab[], for prefetching */\n\
+	return tab + (((uint_fast64_t)(lo & 0xffffffffU) * nbkt) >> 32U);\n\
+}");
+	return;
+}
 
-	for (size_t i = 0U; i < tups->keys->n; i++) {
-		register phash_t a = tups->tups[i].a;
-		register phash_t b = tups->tups[i].b;
-		register phash_t h = a ^ tups->bmap[b] & (tups->smax - 1U);
+static size_t*
+phtups_ranks(phtups_t tups)
+{
+/* return an array mapping slots to the number of occupied slots
+ * before them, i.e. the key's index in a table without holes */
+	size_t *res = calloc(tups->smax + 1U, sizeof(*res));
 
-		printf("\t\t[0x%zx] = \"%s\",\n", h, tups->keys->k[i]);
+	for (size_t i = 0U; i < tups->keys->n; i++) {
+		res[phtups_slot(tups, i) + 1U] = 1U;
 	}
+	for (size_t x = 0U; x < tups->smax; x++) {
+		res[x + 1U] += res[x];
+	}
+	return res;
+}
+
+static void
+ph_genc_rank(phtups_t tups, const size_t *ranks)
+{
+/* emit the rank layer, one 64bit word per 32 slots, holding the
+ * occupancy bits of the slots in the lower half and the rank of the
+ * first slot in the upper half, so ph_rank() costs one load */
+	const size_t nwrd = (tups->smax + 31U) / 32U;
 
+	puts("\n\
+/* occupied slots in the lower 32 bits, rank of the first slot above */\n\
+static const uint64_t rnk[] = {");
+	for (size_t w = 0U; w < nwrd; w++) {
+		uint_fast64_t occ = 0U;
+
+		for (size_t x = w * 32U; x < (w + 1U) * 32U && x < tups->smax; x++) {
+			occ |= (uint_fast64_t)(ranks[x + 1U] > ranks[x]) << (x % 32U);
+		}
+		printf("0x%zx%08lxULL,%c", ranks[w * 32U], occ,
+		       (w % 4U) == 3U ? '\n' : ' ');
+	}
+	if (nwrd % 4U) {
+		putchar('\n');
+	}
 	puts("};\n\
-	register phash_t x = phash(key, len, salt);\n\
-	x = (x >> blog) ^ tab[x & ((1U << blog) - 1U)];\n\
 \n\
-	return t[x & ((1U << slog) - 1U)];\n\
-}\n");
+#if defined __GNUC__\n\
+# define ph_popcnt(x)	__builtin_popcountll(x)\n\
+#else  /* !__GNUC__ */\n\
+static inline unsigned int\n\
+ph_popcnt(uint_fast64_t x)\n\
+{\n\
+	x -= (x >> 1U) & 0x5555555555555555ULL;\n\
+	x = (x & 0x3333333333333333ULL) + ((x >> 2U) & 0x3333333333333333ULL);\n\
+	x = (x + (x >> 4U)) & 0x0f0f0f0f0f0f0f0fULL;\n\
+	return (x * 0x0101010101010101ULL) >> 56U;\n\
+}\n\
+#endif	/* __GNUC__ */\n\
+\n\
+static inline size_t\n\
+ph_rank(size_t x)\n\
+{\n\
+/* return the rank of slot X or (size_t)-1 if X is vacant */\n\
+	register uint_fast64_t e = rnk[x / 32U];\n\
+	register uint_fast64_t m = (uint_fast64_t)1U << (x % 32U);\n\
+\n\
+	if (!(e & m)) {\n\
+		return (size_t)-1;\n\
+	}\n\
+	return (e >> 32U) + ph_popcnt(e & (m - 1U));\n\
+}");
 	return;
 }
 
-
-#include "phashist.yucc"
-
-int
-main(int argc, char *argv[])
+static void
+ph_genc_kpos(phtups_t tups)
 {
-	yuck_t argi[1U] = {PHASHIST_CMD_NONE};
-	int rc = 0;
+/* emit code that puts the bytes at key positions and the key length
+ * into h[] just like phvec_gather(), bounds checks are only emitted
+ * for positions that some key is too short for, strings shorter than
+ * all keys return early instead */
+	const phkpos_t kp = tups->kpos;
+	const size_t nw = keypos_nword(kp);
+	size_t minl = -1UL;
+	bool uncheckedp = false;
 
-	if (yuck_parse(argi, argc, argv) < 0) {
-		rc = 1;
-		goto out;
+	for (size_t i = 0U; i < tups->keys->n; i++) {
+		const size_t kz = phvec_keylen(tups->keys, i);
+
+		if (kz < minl) {
+			minl = kz;
+		}
 	}
+	for (size_t j = 0U; j < kp->n; j++) {
+		const int p = kp->pos[j];
 
-	if (argi->hash_arg) {
-		const char *h = argi->hash_arg;
-		phfun_t f = PHASH_UNK;
+		uncheckedp |= p >= 0 ? (size_t)p < minl : (size_t)-p <= minl;
+	}
 
-		if (!strcmp(h, "bob")) {
-			f = PHASH_BOB;
-		} else if (!strcmp(h, "oat")) {
-			f = PHASH_OAT;
-		} else if (!strcmp(h, "jsw")) {
-			f = PHASH_JSW;
-		} else if (!strcmp(h, "bingo")) {
-			f = PHASH_BINGO;
-		} else if (!strcmp(h, "icke2")) {
-			f = PHASH_ICKE2;
-		} else if (!strcmp(h, "murmur")) {
-			f = PHASH_MURMUR;
+	if (uncheckedp) {
+		printf("\
+	if (len < %zuU) {\n\
+		/* shorter than any key, ph_check() will say no */\n\
+		*hi = 0U;\n\
+		return 0U;\n\
+	}\n", minl);
+	}
+	fputs("\t/* bytes at key positions ", stdout);
+	keypos_fprint(stdout, kp);
+	printf(" and the key length */\n\
+	const uint8_t *k = (const uint8_t*)key;\n\
+	const uint64_t h[%zuU] = {", nw);
+	for (size_t j = 0U; j < kp->n + 4U; j++) {
+		const int p = j < kp->n ? kp->pos[j] : 0;
+
+		fputs(j % 8U ? " |\n\t\t" : "\n\t\t", stdout);
+		if (j >= kp->n) {
+			printf("(uint64_t)(uint8_t)(len >> %zuU)", 8U * (j - kp->n));
+		} else if (p >= 0 && (size_t)p < minl) {
+			printf("(uint64_t)k[%dU]", p);
+		} else if (p >= 0) {
+			printf("(uint64_t)(len > %dU ? k[%dU] : 0U)", p, p);
+		} else if ((size_t)-p <= minl) {
+			printf("(uint64_t)k[len - %dU]", -p);
+		} else {
+			printf("(uint64_t)(len >= %dU ? k[len - %dU] : 0U)",
+			       -p, -p);
+		}
+		printf(" << %zuU", 8U * (j % 8U));
+		if (j % 8U == 7U || j + 1U == kp->n + 4U) {
+			putchar(',');
 		}
-		set_phash(f);
 	}
+	puts("\n\t};");
+	return;
+}
 
-	with (phvec_t keys = ph_read_keys(*argi->args)) {
-		switch (argi->cmd) {
-		case PHASHIST_CMD_BUILD: {
-			const char *karg;
-			phtups_t t;
-			phcnt_t k = 1U;
+static void
+ph_genc_rtype(const phopt_t *opt)
+{
+/* emit the type that lookups return */
+	if (opt->gperf != NULL && opt->gperf->stag != NULL) {
+		printf("const struct %s*", opt->gperf->stag);
+	} else {
+		fputs("const char*", stdout);
+	}
+	return;
+}
 
-			if ((karg = argi->build.dashk_arg)) {
-				char *on;
-				if (!(k = strtoul(karg, &on, 0)) || *on) {
-					errno = 0, error("\
-Invalid argument to -k: `%s'\n\
-Valid values are integers >= 1", karg);
-					break;
+static void
+ph_genc_key(phtups_t tups, const phopt_t *opt)
+{
+/* emit ph_hash(), ph_slot() and hash() for whole keys, see
+ * phtups_keyhash(), or for the bytes at key positions */
+	const char *arg = "(const uint8_t*)key, len";
+
+	puts("\n\
+static inline phash_t\n\
+ph_hash(phash_t *hi, const char *key, size_t len)\n\
+{\n\
+/* return the low hash word of KEY, the high word goes to *HI */");
+	if (tups->kpos != NULL) {
+		ph_genc_kpos(tups);
+		arg = "(const uint8_t*)h, sizeof(h)";
+	}
+	if (phtups_hiwordp(tups)) {
+		printf("\t*hi = phash_hi(%s, ~salt);\n", arg);
+	} else {
+		puts("\t*hi = 0U;");
+	}
+	printf("\treturn phash(%s, salt);\n}\n", arg);
+	puts("\n\
+static inline size_t\n\
+ph_slot(const char *key, size_t len)\n\
+{\n\
+	phash_t hi;\n\
+	phash_t lo = ph_hash(&hi, key, len);\n\
+\n\
+	return ph_slot_h(lo, hi);\n\
+}");
+	fputs("\nstatic inline ", stdout);
+	ph_genc_rtype(opt);
+	puts("\n\
+hash(const char *key, size_t len)\n\
+{\n\
+	return ph_check(ph_slot(key, len), key, len);\n\
+}");
+	return;
+}
+
+static void
+ph_genc_batch(const phopt_t *opt, const char *kw)
+{
+/* emit hash_batch(), lookups in groups of PH_BATCH keys, first hash
+ * them all and prefetch their tab[] entries, then compute the slots
+ * and prefetch those, then check the keys, so the cache misses of
+ * a group overlap rather than queue up */
+	const phgperf_t gp = opt->gperf;
+
+	puts("\n\
+#if !defined PH_BATCH\n\
+# define PH_BATCH	(16U)\n\
+#endif	/* !PH_BATCH */\n\
+#if defined __GNUC__\n\
+# define ph_prefetch(x)	__builtin_prefetch(x)\n\
+#else  /* !__GNUC__ */\n\
+# define ph_prefetch(x)	((void)(x))\n\
+#endif	/* __GNUC__ */\n\
+\n\
+static inline void\n\
+hash_batch(const char *const *keys, const size_t *lens, size_t n,");
+	if (gp != NULL && gp->stag != NULL) {
+		printf("\t   const struct %s **out)\n", gp->stag);
+	} else {
+		puts("\t   const char **out)");
+	}
+	puts("\
+{\n\
+/* like out[i] = hash(keys[i], lens[i]) for i in 0..N-1 */\n\
+	for (size_t i0 = 0U; i0 < n; i0 += PH_BATCH) {\n\
+		const size_t m = n - i0 < PH_BATCH ? n - i0 : PH_BATCH;\n\
+		phash_t lo[PH_BATCH];\n\
+		phash_t hi[PH_BATCH];\n\
+		size_t x[PH_BATCH];\n\
+\n\
+		for (size_t i = 0U; i < m; i++) {\n\
+			lo[i] = ph_hash(hi + i, keys[i0 + i], lens[i0 + i]);\n\
+			ph_prefetch(ph_tabp(lo[i]));\n\
+		}\n\
+		for (size_t i = 0U; i < m; i++) {\n\
+			x[i] = ph_slot_h(lo[i], hi[i]);");
+	if (opt->minimal) {
+		puts("\t\t\tph_prefetch(rnk + x[i] / 32U);");
+	} else if (opt->layout == PHLAYOUT_INLINE) {
+		/* length and key share the slot */
+		printf("\t\t\tph_prefetch(%s + x[i]);\n", kw);
+	} else {
+		printf("\
+			ph_prefetch(%s + x[i]);\n\
+			ph_prefetch(ph_kwlen + x[i]);\n", kw);
+	}
+	puts("\
+		}\n\
+		for (size_t i = 0U; i < m; i++) {\n\
+			out[i0 + i] = ph_check(x[i], keys[i0 + i], lens[i0 + i]);\n\
+		}\n\
+	}\n\
+	return;\n\
+}");
+	return;
+}
+
+static void
+ph_genc_prefix(phtups_t tups, const phopt_t *opt)
+{
+/* emit ph_chain(), hash() and hash_prefix() for prefix tables,
+ * the hash of a prefix of length ph_plen[i] is continued from the
+ * hash of the prefix of length ph_plen[i - 1], see phtups_keyhash() */
+	const phvec_stats_t pfx = tups->pfx;
+	const bool hiwordp = phtups_hiwordp(tups);
+	size_t np = 0U;
+
+	printf("\n\
+/* key lengths in ascending order */\n\
+static const %s ph_plen[] = {\n", uint_type(pfx->max));
+	for (size_t l = pfx->min; l <= pfx->max; l++) {
+		if (!pfx->lens[l - pfx->min]) {
+			continue;
+		}
+		printf("%zuU,%c", l, (np++ % 8U) == 7U ? '\n' : ' ');
+	}
+	puts("\n};");
+	printf("#define ph_nplen	(%zuU)\n", np);
+
+	puts("\n\
+static inline size_t\n\
+ph_chain(phash_t *lo, phash_t *hi, const char *key, size_t len)\n\
+{\n\
+/* hash all prefixes of KEY whose length is a key length,\n\
+ * return the number of prefixes hashed */\n\
+	register phash_t clo = salt;\n\
+	register phash_t chi = ~salt;\n\
+	size_t n = 0U;\n\
+\n\
+	for (size_t o = 0U; n < ph_nplen && ph_plen[n] <= len; o = ph_plen[n++]) {\n\
+		const uint8_t *s = (const uint8_t*)key + o;\n\
+\n\
+		if (o) {\n\
+			clo = phash_mix(clo);");
+	if (hiwordp) {
+		puts("\
+			chi = phash_mix(chi);");
+	}
+	puts("\
+		}\n\
+		clo = phash(s, ph_plen[n] - o, clo);");
+	if (hiwordp) {
+		puts("\
+		chi = phash_hi(s, ph_plen[n] - o, chi);");
+	}
+	puts("\
+		lo[n] = clo;\n\
+		hi[n] = chi;\n\
+	}\n\
+	return n;\n\
+}");
+	fputs("\nstatic inline ", stdout);
+	ph_genc_rtype(opt);
+	puts("\n\
+hash(const char *key, size_t len)\n\
+{\n\
+	phash_t lo[ph_nplen];\n\
+	phash_t hi[ph_nplen];\n\
+	size_t n = ph_chain(lo, hi, key, len);\n\
+\n\
+	if (!n-- || ph_plen[n] != len) {\n\
+		return NULL;\n\
+	}");
+	puts("\
+	return ph_check(ph_slot_h(lo[n], hi[n]), key, len);\n\
+}");
+	fputs("\nstatic inline ", stdout);
+	ph_genc_rtype(opt);
+	puts("\n\
+hash_prefix(const char *key, size_t len)\n\
+{\n\
+/* return the longest key that is a prefix of KEY */\n\
+	phash_t lo[ph_nplen];\n\
+	phash_t hi[ph_nplen];\n\
+\n\
+	for (size_t n = ph_chain(lo, hi, key, len); n-- > 0U;) {");
+	fputs("\t\t", stdout);
+	ph_genc_rtype(opt);
+	puts(" k;\n");
+	puts("\
+		k = ph_check(ph_slot_h(lo[n], hi[n]), key, ph_plen[n]);\n\
+		if (k != NULL) {\n\
+			return k;\n\
+		}\n\
+	}\n\
+	return NULL;\n\
+}");
+	return;
+}
+
+static void
+ph_genc_ptrs(phtups_t tups, const phopt_t *opt, const size_t *ranks, size_t nt)
+{
+/* emit ph_kw[], the keys (or gperf structs) by slot, and ph_kwlen[] */
+	const phgperf_t gp = opt->gperf;
+	const bool structp = gp != NULL && gp->stag != NULL;
+	const char *kw = structp ? gp->wordlist : "ph_kw";
+	size_t maxl = 0U;
+
+	if (structp) {
+		printf("\n\
+static const struct %s %s[%zuU] = {\n", gp->stag, kw, nt);
+	} else {
+		printf("\n\
+static const char *const ph_kw[%zuU] = {\n", nt);
+	}
+	for (size_t i = 0U; i < tups->keys->n; i++) {
+		const size_t x = phtups_slot(tups, i);
+		const size_t kz = phvec_keylen(tups->keys, i);
+
+		printf("\t[0x%zx] = ", ranks ? ranks[x] : x);
+		if (structp) {
+			/* the fields are pasted as is, like gperf does */
+			putchar('{');
+			ph_genc_str(phvec_key(tups->keys, i), kz);
+			printf(",%s},\n", tups->keys->vals[i]);
+		} else {
+			ph_genc_str(phvec_key(tups->keys, i), kz);
+			puts(",");
+		}
+		if (kz > maxl) {
+			maxl = kz;
+		}
+	}
+	puts("};");
+
+	printf("static const %s ph_kwlen[%zuU] = {\n", uint_type(maxl), nt);
+	for (size_t i = 0U; i < tups->keys->n; i++) {
+		const size_t x = phtups_slot(tups, i);
+
+		printf("\t[0x%zx] = %zuU,\n",
+		       ranks ? ranks[x] : x, phvec_keylen(tups->keys, i));
+	}
+	puts("};");
+	return;
+}
+
+static void
+ph_genc_pool(phtups_t tups, const size_t *ranks, size_t nt)
+{
+/* emit the keys as one string ph_pool[] and per slot offsets and
+ * lengths into it, unlike pointers none of this needs relocating so
+ * it stays in .rodata and is shared among processes */
+	size_t poolz = 0U;
+	size_t maxl = 0U;
+
+	puts("\n\
+/* the keys, each followed by a NUL, in key order */\n\
+static const char ph_pool[] =");
+	for (size_t i = 0U; i < tups->keys->n; i++) {
+		const size_t kz = phvec_keylen(tups->keys, i);
+
+		putchar('\t');
+		ph_genc_str(phvec_key(tups->keys, i), kz);
+		puts(" \"\\0\"");
+		poolz += kz + 1U;
+		if (kz > maxl) {
+			maxl = kz;
+		}
+	}
+	puts("\t\"\";");
+
+	printf("static const %s ph_kwoff[%zuU] = {\n", uint_type(poolz), nt);
+	poolz = 0U;
+	for (size_t i = 0U; i < tups->keys->n; i++) {
+		const size_t x = phtups_slot(tups, i);
+
+		printf("\t[0x%zx] = %zuU,\n", ranks ? ranks[x] : x, poolz);
+		poolz += phvec_keylen(tups->keys, i) + 1U;
+	}
+	puts("};");
+
+	puts("/* key lengths plus one, 0 for vacant slots */");
+	printf("static const %s ph_kwlen[%zuU] = {\n", uint_type(maxl + 1U), nt);
+	for (size_t i = 0U; i < tups->keys->n; i++) {
+		const size_t x = phtups_slot(tups, i);
+
+		printf("\t[0x%zx] = %zuU,\n",
+		       ranks ? ranks[x] : x, phvec_keylen(tups->keys, i) + 1U);
+	}
+	puts("};");
+	return;
+}
+
+static void
+ph_genc_bytes(phkey_t k, size_t z)
+{
+/* emit the Z bytes at K as initialiser list, unlike string literals
+ * these needn't leave room for a terminator */
+	putchar('{');
+	for (size_t i = 0U; i < z; i++) {
+		printf("%s0x%02xU", i ? ", " : "", k[i]);
+	}
+	putchar('}');
+	return;
+}
+
+static bool
+ph_genc_inline(phtups_t tups, const size_t *ranks, size_t nt)
+{
+/* emit ph_kws[], slots of 16 or 32 bytes holding the key length and,
+ * if it fits, the key itself so checking a short key touches just one
+ * cache line, longer keys live in ph_pool[] and the slot keeps their
+ * offset and first and last few bytes to weed out most mismatches,
+ * 16 byte slots are used if 7/8 of the keys fit,
+ * return whether there are long keys at all */
+	size_t slotz = 16U;
+	size_t inmax, htz;
+	size_t nlong = 0U;
+	size_t poolz = 0U;
+	uint8_t ht[32U];
+
+	for (size_t i = 0U; i < tups->keys->n; i++) {
+		nlong += phvec_keylen(tups->keys, i) > slotz - 3U;
+	}
+	if (nlong > tups->keys->n / 8U) {
+		slotz = 32U;
+		nlong = 0U;
+		for (size_t i = 0U; i < tups->keys->n; i++) {
+			nlong += phvec_keylen(tups->keys, i) > slotz - 3U;
+		}
+	}
+	/* 2 bytes length, inline keys are NUL-terminated,
+	 * long keys have their 4 byte offset instead */
+	inmax = slotz - 3U;
+	htz = (slotz - 6U) / 2U;
+
+	printf("\n\
+typedef struct {\n\
+	/* key length plus one, 0 for vacant slots */\n\
+	uint16_t len;\n\
+	union {\n\
+		char kw[%zuU];\n\
+		/* offset into ph_pool[] in 16 bit halves, and\n\
+		 * the first and last few bytes of the key */\n\
+		struct {\n\
+			uint16_t off[2U];\n\
+			uint8_t ht[%zuU];\n\
+		} lk;\n\
+	} u;\n\
+} ph_slot_t;\n", slotz - 2U, 2U * htz);
+	if (nlong) {
+		/* a pool without keys would trip up compilers' bounds checks */
+		printf("\n\
+/* keys of up to ph_inmax bytes are stored inline */\n\
+static const size_t ph_inmax = %zuU;\n\
+static const size_t ph_htz = %zuU;\n\
+\n\
+/* long keys, each followed by a NUL */\n\
+static const char ph_pool[] =\n", inmax, htz);
+		for (size_t i = 0U; i < tups->keys->n; i++) {
+			const size_t kz = phvec_keylen(tups->keys, i);
+
+			if (kz <= inmax) {
+				continue;
+			}
+			putchar('\t');
+			ph_genc_str(phvec_key(tups->keys, i), kz);
+			puts(" \"\\0\"");
+		}
+		puts("\t\"\";");
+	}
+
+	puts("\n\
+#if defined __GNUC__\n\
+# define ph_aligned	__attribute__((aligned(64)))\n\
+#else  /* !__GNUC__ */\n\
+# define ph_aligned\n\
+#endif	/* __GNUC__ */");
+	printf("static const ph_slot_t ph_kws[%zuU] ph_aligned = {\n", nt);
+	for (size_t i = 0U; i < tups->keys->n; i++) {
+		const size_t x = phtups_slot(tups, i);
+		const phkey_t k = phvec_key(tups->keys, i);
+		const size_t kz = phvec_keylen(tups->keys, i);
+
+		printf("\t[0x%zx] = {%zuU, ", ranks ? ranks[x] : x, kz + 1U);
+		if (kz <= inmax) {
+			fputs("{.kw = ", stdout);
+			ph_genc_str(k, kz);
+			puts("}},");
+			continue;
+		}
+		printf("{.lk = {{0x%zxU, 0x%zxU}, ",
+		       poolz & 0xffffU, poolz >> 16U);
+		memcpy(ht, k, htz);
+		memcpy(ht + htz, k + kz - htz, htz);
+		ph_genc_bytes(ht, 2U * htz);
+		puts("}}},");
+		poolz += kz + 1U;
+	}
+	puts("};");
+	return nlong > 0U;
+}
+
+static void
+ph_genc_vals(phtups_t tups, const phopt_t *opt, const size_t *ranks, size_t nt)
+{
+/* emit ph_val[], the values by slot, keys without one get PH_NOVALUE */
+	printf("\n\
+#if !defined PH_NOVALUE\n\
+/* what hash_value() returns for strings that aren't keys */\n\
+# define PH_NOVALUE	(0)\n\
+#endif	/* !PH_NOVALUE */\n\
+static const %s ph_val[%zuU] = {\n", opt->vtype, nt);
+	for (size_t i = 0U; i < tups->keys->n; i++) {
+		const size_t x = phtups_slot(tups, i);
+		const char *v = tups->keys->vals[i];
+
+		printf("\t[0x%zx] = %s,\n", ranks ? ranks[x] : x,
+		       *v ? v : "PH_NOVALUE");
+	}
+	puts("};");
+	return;
+}
+
+static void
+ph_genc_value(const phopt_t *opt)
+{
+/* emit ph_value() and hash_value(), like ph_check() and hash() */
+	printf("\n\
+static inline %s\n\
+ph_value(size_t x, const char *key, size_t len)\n\
+{\n\
+	if (ph_check(x, key, len) == NULL) {\n\
+		return PH_NOVALUE;\n\
+	}\n\
+	return ph_val[%s];\n\
+}\n", opt->vtype, opt->minimal ? "ph_rank(x)" : "x");
+	printf("\n\
+static inline %s\n\
+hash_value(const char *key, size_t len)\n\
+{\n\
+	return ph_value(ph_slot(key, len), key, len);\n\
+}\n", opt->vtype);
+	return;
+}
+
+static void
+ph_genc(phtups_t tups, const phopt_t *opt)
+{
+	const phgperf_t gp = opt->gperf;
+	/* gperf keywords with struct fields, ph_kw[] is the struct array */
+	const bool structp = gp != NULL && gp->stag != NULL;
+	const char *kw = structp ? gp->wordlist
+		: opt->layout == PHLAYOUT_POOL ? "ph_kwoff"
+		: opt->layout == PHLAYOUT_INLINE ? "ph_kws" : "ph_kw";
+	size_t *ranks = NULL;
+	/* inline layout only, whether some keys went to ph_pool[] */
+	bool longp = false;
+
+	if (gp != NULL && gp->prologue != NULL) {
+		fputs(gp->prologue, stdout);
+	}
+	puts("#include <stddef.h>");
+	puts("#include <stdint.h>");
+	puts("#include <string.h>\n");
+	if (gp != NULL && gp->decl != NULL && !gp->omit_struct) {
+		puts(gp->decl);
+	}
+
+	puts("typedef uint_fast32_t phash_t;");
+	printf("static const phash_t salt = 0x%zxU * 0x9e3779b9U;\n", tups->salt);
+
+	switch (tups->algo) {
+	case PHALGO_BOB:
+		ph_genc_bob(tups);
+		break;
+	case PHALGO_CHD:
+		ph_genc_chd(tups);
+		break;
+	default:
+		abort();
+	}
+
+	if (opt->minimal) {
+		ranks = phtups_ranks(tups);
+		ph_genc_rank(tups, ranks);
+	}
+
+	with (const size_t nt = ranks ? tups->keys->n : tups->smax) {
+		switch (opt->layout) {
+		case PHLAYOUT_PTR:
+			ph_genc_ptrs(tups, opt, ranks, nt);
+			break;
+		case PHLAYOUT_POOL:
+			ph_genc_pool(tups, ranks, nt);
+			break;
+		case PHLAYOUT_INLINE:
+			longp = ph_genc_inline(tups, ranks, nt);
+			break;
+		default:
+			abort();
+		}
+		if (opt->vtype != NULL) {
+			ph_genc_vals(tups, opt, ranks, nt);
+		}
+	}
+
+	fputs("\nstatic inline ", stdout);
+	ph_genc_rtype(opt);
+	puts("\n\
+ph_check(size_t x, const char *key, size_t len)\n\
+{");
+	if (opt->minimal) {
+		printf("\
+	x = ph_rank(x);\n\
+	if (x >= sizeof(%s) / sizeof(*%s)) {\n\
+		return NULL;\n\
+	}\n", kw, kw);
+	}
+	if (structp) {
+		printf("\
+	/* check that it's really KEY */\n\
+	if (%s[x].%s == NULL || ph_kwlen[x] != len || memcmp(%s[x].%s, key, len)) {\n\
+		return NULL;\n\
+	}\n\
+	return %s + x;\n\
+}\n", kw, gp->slot, kw, gp->slot, kw);
+	} else if (opt->layout == PHLAYOUT_INLINE && !longp) {
+		puts("\
+	/* check that it's really KEY, vacant slots have length 0 */\n\
+	register const ph_slot_t *s = ph_kws + x;\n\
+\n\
+	if (!s->len || s->len - 1U != len || memcmp(s->u.kw, key, len)) {\n\
+		return NULL;\n\
+	}\n\
+	return s->u.kw;\n\
+}");
+	} else if (opt->layout == PHLAYOUT_INLINE) {
+		puts("\
+	/* check that it's really KEY, vacant slots have length 0 */\n\
+	register const ph_slot_t *s = ph_kws + x;\n\
+	register size_t o;\n\
+\n\
+	if (!s->len || s->len - 1U != len) {\n\
+		return NULL;\n\
+	} else if (len <= ph_inmax) {\n\
+		return memcmp(s->u.kw, key, len) ? NULL : s->u.kw;\n\
+	}\n\
+	/* long keys, compare head and tail before going to the pool */\n\
+	if (memcmp(s->u.lk.ht, key, ph_htz) ||\n\
+	    memcmp(s->u.lk.ht + ph_htz, key + len - ph_htz, ph_htz)) {\n\
+		return NULL;\n\
+	}\n\
+	o = s->u.lk.off[0U] | (size_t)s->u.lk.off[1U] << 16U;\n\
+	return memcmp(ph_pool + o, key, len) ? NULL : ph_pool + o;\n\
+}");
+	} else if (opt->layout == PHLAYOUT_POOL) {
+		puts("\
+	/* check that it's really KEY, vacant slots have length 0 */\n\
+	if (!ph_kwlen[x] || ph_kwlen[x] - 1U != len ||\n\
+	    memcmp(ph_pool + ph_kwoff[x], key, len)) {\n\
+		return NULL;\n\
+	}\n\
+	return ph_pool + ph_kwoff[x];\n\
+}");
+	} else {
+		puts("\
+	/* check that it's really KEY */\n\
+	if (ph_kw[x] == NULL || ph_kwlen[x] != len || memcmp(ph_kw[x], key, len)) {\n\
+		return NULL;\n\
+	}\n\
+	return ph_kw[x];\n\
+}");
+	}
+
+	if (tups->pfx == NULL) {
+		ph_genc_key(tups, opt);
+		ph_genc_batch(opt, kw);
+	} else {
+		ph_genc_prefix(tups, opt);
+	}
+	if (opt->vtype != NULL) {
+		ph_genc_value(opt);
+	}
+	free(ranks);
+
+	if (gp != NULL) {
+		/* gperf's lookup function and the user's code */
+		putchar('\n');
+		ph_genc_rtype(opt);
+		printf("\n\
+%s(const char *str, size_t len)\n\
+{\n\
+	return hash(str, len);\n\
+}\n", gp->lookup);
+		if (gp->epilogue != NULL) {
+			fputs(gp->epilogue, stdout);
+		}
+	}
+	return;
+}
+
+static int
+ph_genbin(phtups_t tups)
+{
+/* write TUPS as blob, see phblob.h */
+	size_t z;
+	void *blob;
+	int rc = 0;
+
+	if (UNLIKELY((blob = phblob_make(tups, &z)) == NULL)) {
+		error("cannot serialise table");
+		return -1;
+	} else if (fwrite(blob, 1U, z, stdout) < z || fflush(stdout)) {
+		error("cannot write table");
+		rc = -1;
+	}
+	free(blob);
+	return rc;
+}
+
+
+/* perf command */
+typedef enum {
+	PHCYC_NONE,
+	/* core cycles in user space, through perf_event_open(2) */
+	PHCYC_PERF,
+	/* reference cycles of the time stamp counter */
+	PHCYC_TSC,
+} phcyc_t;
+
+typedef struct {
+	/* number of timed samples */
+	size_t niter;
+	/* which cycle counter to read alongside the clock */
+	phcyc_t cyc;
+	int cycfd;
+} perfopt_t;
+
+/* a sample hashes at least this many keys, small key sets are
+ * hashed repeatedly so clock resolution doesn't dominate */
+#define PERF_MINHASH	(4096U)
+
+static inline uint_fast64_t
+perf_nsec(void)
+{
+	struct timespec tsp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tsp);
+	return tsp.tv_sec * 1000000000ULL + tsp.tv_nsec;
+}
+
+static phcyc_t
+perf_cycopen(int *fd)
+{
+/* find a cycle counter, prefer perf_event's core cycles */
+#if defined HAVE_LINUX_PERF_EVENT_H && defined SYS_perf_event_open
+	struct perf_event_attr pe = {
+		.type = PERF_TYPE_HARDWARE,
+		.size = sizeof(pe),
+		.config = PERF_COUNT_HW_CPU_CYCLES,
+		.exclude_kernel = 1U,
+		.exclude_hv = 1U,
+	};
+
+	if ((*fd = syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0)) >= 0) {
+		return PHCYC_PERF;
+	}
+#endif	/* HAVE_LINUX_PERF_EVENT_H */
+	*fd = -1;
+#if defined HAVE_X86INTRIN_H && (defined __x86_64__ || defined __i386__)
+	return PHCYC_TSC;
+#else  /* !x86 */
+	return PHCYC_NONE;
+#endif	/* x86 */
+}
+
+static inline uint_fast64_t
+perf_cycles(const perfopt_t *opt)
+{
+	switch (opt->cyc) {
+	case PHCYC_PERF: {
+		uint64_t c;
+
+		if (UNLIKELY(read(opt->cycfd, &c, sizeof(c)) < (ssize_t)sizeof(c))) {
+			break;
+		}
+		return c;
+	}
+	case PHCYC_TSC:
+#if defined HAVE_X86INTRIN_H && (defined __x86_64__ || defined __i386__)
+		return __rdtsc();
+#endif	/* x86 */
+	case PHCYC_NONE:
+	default:
+		break;
+	}
+	return 0U;
+}
+
+static phash_t
+perf_pass(phvec_t keys, size_t npass, phash_f hf)
+{
+	phash_t sum = 0U;
+
+	for (size_t j = 0U; j < npass; j++) {
+		for (size_t i = 0U; i < keys->n; i++) {
+			phkey_t k = phvec_key(keys, i);
+			const size_t z = phvec_keylen(keys, i);
+
+			sum += hf(k, z, 0x94U);
+		}
+	}
+	return sum;
+}
+
+static uint_fast64_t
+perf_pctl(uint_fast64_t *smp, size_t n, unsigned int pct)
+{
+/* return the PCT-th percentile (nearest rank) of SMP, sorting SMP */
+	qsort(smp, n, sizeof(*smp), u64_cmp);
+	return smp[(n * pct + 99U) / 100U - (n > 0U)];
+}
+
+static void
+ph_perf(phvec_t keys, const char *name, phash_f hf, const perfopt_t *opt)
+{
+/* time hash routine HF over KEYS and print a line of stats */
+	const size_t npass = (PERF_MINHASH + keys->n - 1U) / keys->n;
+	const size_t nhash = npass * keys->n;
+	size_t nbyte = 0U;
+	uint_fast64_t *ns = calloc(opt->niter, sizeof(*ns));
+	uint_fast64_t *cy = calloc(opt->niter, sizeof(*cy));
+	volatile phash_t sink = 0U;
+	uint_fast64_t ns50, ns99;
+
+	for (size_t i = 0U; i < keys->n; i++) {
+		nbyte += phvec_keylen(keys, i);
+	}
+	nbyte *= npass;
+
+	/* warm up caches and branch predictors */
+	for (size_t j = 0U; j < opt->niter / 10U + 1U; j++) {
+		sink += perf_pass(keys, npass, hf);
+	}
+	for (size_t j = 0U; j < opt->niter; j++) {
+		const uint_fast64_t c0 = perf_cycles(opt);
+		const uint_fast64_t t0 = perf_nsec();
+
+		sink += perf_pass(keys, npass, hf);
+		ns[j] = perf_nsec() - t0;
+		cy[j] = perf_cycles(opt) - c0;
+	}
+	(void)sink;
+
+	ns50 = perf_pctl(ns, opt->niter, 50U);
+	ns99 = perf_pctl(ns, opt->niter, 99U);
+	printf("%-12s %10.3f %10.3f %10.3f %8.3f",
+	       name,
+	       (double)ns50 / (double)nhash, (double)ns99 / (double)nhash,
+	       (double)((uint_fast64_t)nhash * 1000U) / (double)ns50,
+	       (double)nbyte / (double)ns50);
+	if (opt->cyc) {
+		const uint_fast64_t cy50 = perf_pctl(cy, opt->niter, 50U);
+		const uint_fast64_t cy99 = perf_pctl(cy, opt->niter, 99U);
+
+		printf(" %10.3f %10.3f",
+		       (double)cy50 / (double)nhash,
+		       (double)cy99 / (double)nhash);
+	}
+	putchar('\n');
+
+	free(ns);
+	free(cy);
+	return;
+}
+
+
+/* build --hash=auto */
+static size_t
+phtups_tabz(phtups_t tups)
+{
+/* return the number of bytes ph_genc_bob() or ph_genc_chd() emit */
+	phash_t max = 0U;
+	size_t nexc = 0U;
+
+	for (size_t i = 0U; i < tups->blen; i++) {
+		if (tups->bmap[i] > max) {
+			max = tups->bmap[i];
+		}
+	}
+	switch (tups->algo) {
+	case PHALGO_CHD:
+		nexc = chd_nexc(tups);
+		return tups->blen +
+			nexc * (uint_size(tups->blen - 1U) + uint_size(max));
+	case PHALGO_BOB:
+	default:
+		break;
+	}
+	return tups->blen * uint_size(max);
+}
+
+static double
+phtups_cost(phtups_t tups, size_t niter)
+{
+/* return the median time in ns to hash a key the way the
+ * generated lookup does */
+	const size_t n = tups->keys->n;
+	const size_t npass = (PERF_MINHASH + n - 1U) / n;
+	const phash_t ilev = salt_ilev(tups->salt);
+	const bool hiwordp = phtups_hiwordp(tups);
+	uint_fast64_t *ns = calloc(niter, sizeof(*ns));
+	volatile phash_t sink = 0U;
+	uint_fast64_t ns50;
+
+	for (size_t j = 0U; j <= niter; j++) {
+		const uint_fast64_t t0 = perf_nsec();
+		phash_t sum = 0U;
+
+		for (size_t p = 0U; p < npass; p++) {
+			for (size_t i = 0U; i < n; i++) {
+				phash2_t h = phtups_keyhash(tups, i, ilev, hiwordp);
+				sum += h.lo ^ h.hi;
+			}
+		}
+		sink += sum;
+		/* the first round is warmup */
+		if (j) {
+			ns[j - 1U] = perf_nsec() - t0;
+		}
+	}
+	(void)sink;
+	ns50 = perf_pctl(ns, niter, 50U);
+	free(ns);
+	return (double)ns50 / (double)(npass * n);
+}
+
+static phtups_t
+ph_find_auto(phvec_t keys, const phopt_t *opt)
+{
+/* build a table with every hash routine and keep the one with the
+ * smallest tables, among tables within an eighth of the smallest
+ * keep the one that's fastest to hash */
+#define AUTO_NITER	(15U)
+	phtups_t best = NULL;
+	size_t bestz = 0U;
+	double bestc = 0;
+	/* the smallest tables so far, which need not be BEST's */
+	size_t minz = 0U;
+
+	for (phfun_t f = PHASH_UNK + 1; f < PHASH_NFUN; f++) {
+		phopt_t fopt = *opt;
+		phtups_t t;
+		size_t z;
+		double c;
+
+		fopt.hash = f;
+		if (opt->algo == PHALGO_CHD &&
+		    phash_salting(f) != PHSALT_MIXED) {
+			/* ph_find() would refuse it */
+			continue;
+		}
+		errno = 0, error("trying hash %s", phash_name(f));
+		if ((t = ph_find(keys, &fopt)) == NULL) {
+			continue;
+		}
+		z = phtups_tabz(t);
+		c = phtups_cost(t, AUTO_NITER);
+		errno = 0, error("\
+hash %s: %zu bytes of tables, %.3f ns/key", phash_name(f), z, c);
+
+		if (best == NULL || z < minz) {
+			minz = z;
+		}
+		if (best == NULL ||
+		    /* BEST is no longer within an eighth of the smallest */
+		    bestz > minz + minz / 8U ||
+		    (z <= minz + minz / 8U && c < bestc)) {
+			if (best != NULL) {
+				free_tups(best);
+			}
+			best = t;
+			bestz = z;
+			bestc = c;
+		} else {
+			free_tups(t);
+		}
+	}
+	if (UNLIKELY(best == NULL)) {
+		errno = 0, error("\
+fatal error: no hash function could build a table");
+		return NULL;
+	}
+	errno = 0, error("using hash %s", phash_name(best->hash));
+	return best;
+}
+
+static phfun_t
+ph_pick_hash(phvec_t keys, const phopt_t *opt)
+{
+/* the hash to use when none is given, icke2 for short keys, wy once
+ * keys are long enough on average for its 16 byte steps to pay off,
+ * wy also for key positions as those few bytes tend to look alike and
+ * hashes that merely xor the salt in collide for every salt, and for
+ * CHD which can't do with such hashes at all, see ph_find() */
+#define WY_MINLEN	(16U)
+	size_t tot;
+
+	if (opt->kpos != NULL || opt->algo == PHALGO_CHD) {
+		return PHASH_WY;
+	} else if (UNLIKELY(!keys->n)) {
+		return get_phash();
+	}
+	tot = keys->off[keys->n] - keys->off[0U] - keys->n;
+	return tot > WY_MINLEN * keys->n ? PHASH_WY : get_phash();
+}
+
+
+#include "phashist.yucc"
+
+int
+main(int argc, char *argv[])
+{
+	yuck_t argi[1U] = {PHASHIST_CMD_NONE};
+	int rc = 0;
+	/* --hash=auto */
+	bool autop = false;
+	/* declarations and code of gperf input */
+	phgperf_t gp = NULL;
+
+	if (yuck_parse(argi, argc, argv) < 0) {
+		rc = 1;
+		goto out;
+	}
+
+	if (!argi->hash_arg) {
+		;
+	} else if (!strcmp(argi->hash_arg, "auto")) {
+		if (argi->cmd == PHASHIST_CMD_PRINT) {
+			errno = 0, error("\
+--hash=auto cannot be used with print");
+			rc = 1;
+			goto out;
+		}
+		autop = true;
+	} else with (phfun_t f = phash_byname(argi->hash_arg)) {
+		if (f == PHASH_UNK) {
+			errno = 0, error("\
+Invalid argument to --hash: `%s'", argi->hash_arg);
+			rc = 1;
+			goto out;
+		}
+		set_phash(f);
+	}
+
+	if (argi->value_type_arg &&
+	    (argi->gperf_flag || ph_gperf_namep(*argi->args))) {
+		errno = 0, error("\
+--value-type cannot be used with gperf input");
+		rc = 1;
+		goto out;
+	}
+
+	with (phvec_t keys = argi->gperf_flag || ph_gperf_namep(*argi->args)
+	      ? ph_read_gperf(*argi->args, &gp)
+	      : argi->value_type_arg
+	      ? ph_read_pairs(*argi->args)
+	      : ph_read_keys(*argi->args)) {
+		if (UNLIKELY(keys == NULL)) {
+			error("cannot read keys from `%s'", *argi->args ?: "-");
+			rc = 1;
+			break;
+		}
+		switch (argi->cmd) {
+		case PHASHIST_CMD_BUILD: {
+			const char *karg;
+			bool binp = false;
+			phtups_t t;
+			phopt_t opt = {
+				.algo = PHALGO_BOB,
+				.hash = autop ? PHASH_UNK : get_phash(),
+				.k = 1U,
+				.njobs = 1U,
+				.gperf = gp,
+				.vtype = argi->value_type_arg,
+			};
+
+			if ((karg = argi->build.dashk_arg)) {
+				char *on;
+				if (!(opt.k = strtoul(karg, &on, 0)) || *on) {
+					errno = 0, error("\
+Invalid argument to -k: `%s'\n\
+Valid values are integers >= 1", karg);
+					rc = 1;
+					break;
 				}
 			}
 
-			/* find teh hash */
-			if ((t = ph_find(keys, k)) == NULL) {
+			if ((karg = argi->build.jobs_arg)) {
+				char *on;
+				long int j = strtol(karg, &on, 0);
+
+				if (j <= 0 || *on) {
+					errno = 0, error("\
+Invalid argument to --jobs: `%s'\n\
+Valid values are integers >= 1", karg);
+					rc = 1;
+					break;
+				}
+				opt.njobs = (unsigned int)j;
+			}
+			if ((karg = argi->build.algo_arg)) {
+				if (!strcmp(karg, "bob")) {
+					opt.algo = PHALGO_BOB;
+				} else if (!strcmp(karg, "chd")) {
+					opt.algo = PHALGO_CHD;
+				} else {
+					errno = 0, error("\
+Invalid argument to --algo: `%s'\n\
+Valid values are bob and chd", karg);
+					rc = 1;
+					break;
+				}
+			}
+			if (opt.algo == PHALGO_CHD && argi->hash_arg && !autop &&
+			    phash_salting(opt.hash) != PHSALT_MIXED) {
+				errno = 0, error("\
+--algo=chd cannot be used with --hash=%s", argi->hash_arg);
+				rc = 1;
 				break;
 			}
+			if ((karg = argi->build.layout_arg)) {
+				if (!strcmp(karg, "ptr")) {
+					opt.layout = PHLAYOUT_PTR;
+				} else if (!strcmp(karg, "pool")) {
+					opt.layout = PHLAYOUT_POOL;
+				} else if (!strcmp(karg, "inline")) {
+					opt.layout = PHLAYOUT_INLINE;
+				} else {
+					errno = 0, error("\
+Invalid argument to --layout: `%s'\n\
+Valid values are ptr, pool and inline", karg);
+					rc = 1;
+					break;
+				}
+				if (opt.layout != PHLAYOUT_PTR &&
+				    gp != NULL && gp->stag != NULL) {
+					errno = 0, error("\
+--layout=%s cannot be used with gperf's %%struct-type", karg);
+					rc = 1;
+					break;
+				}
+				if (opt.layout == PHLAYOUT_INLINE &&
+				    ph_maxkeylen(keys) >= UINT16_MAX) {
+					/* slots keep the length plus one in 16 bits */
+					errno = 0, error("\
+--layout=inline cannot hold keys of %u bytes or more", UINT16_MAX);
+					rc = 1;
+					break;
+				}
+			}
 
-			/* generate code */
-			ph_genc(t);
+			if ((karg = argi->build.format_arg)) {
+				if (!strcmp(karg, "c")) {
+					;
+				} else if (!strcmp(karg, "bin")) {
+					binp = true;
+				} else {
+					errno = 0, error("\
+Invalid argument to --format: `%s'\n\
+Valid values are c and bin", karg);
+					rc = 1;
+					break;
+				}
+			}
 
-			free_tups(t);
+			if (argi->build.minimal_flag) {
+				if (opt.k > 1U) {
+					errno = 0, error("\
+minimal tables cannot be k-perfect");
+					rc = 1;
+					break;
+				}
+				opt.minimal = true;
+			}
+			if (argi->build.prefix_flag) {
+				if (opt.vtype != NULL) {
+					errno = 0, error("\
+--prefix cannot be used with --value-type");
+					rc = 1;
+					break;
+				}
+				opt.prefix = true;
+			}
+			if (argi->build.key_positions_flag) {
+				if (opt.prefix) {
+					errno = 0, error("\
+--key-positions cannot be used with --prefix");
+					rc = 1;
+					break;
+				} else if ((opt.kpos = phvec_keypos(keys)) == NULL) {
+					errno = 0, error("\
+no %u key positions tell the keys apart, hashing whole keys",
+							 KEYPOS_MAX);
+				} else if ((opt.hkeys =
+					    phvec_gather(keys, opt.kpos)) == NULL) {
+					error("cannot hash key positions");
+					free(opt.kpos);
+					opt.kpos = NULL;
+				} else {
+					fputs("hashing key positions ", stderr);
+					keypos_fprint(stderr, opt.kpos);
+					fputc('\n', stderr);
+				}
+			}
+			if (binp && (opt.prefix || opt.kpos || opt.k > 1U)) {
+				errno = 0, error("\
+--format=bin cannot be used with --prefix, --key-positions or -k");
+				free(opt.kpos);
+				ph_free_keys(opt.hkeys);
+				rc = 1;
+				break;
+			}
+			if (!autop && !argi->hash_arg) {
+				opt.hash = ph_pick_hash(keys, &opt);
+			}
+
+			/* find teh hash */
+			if ((t = !autop
+			     ? ph_find(keys, &opt)
+			     : ph_find_auto(keys, &opt)) != NULL) {
+				/* generate code */
+				if (!binp) {
+					ph_genc(t, &opt);
+				} else if (ph_genbin(t) < 0) {
+					rc = 1;
+				}
+				free_tups(t);
+			} else {
+				rc = 1;
+			}
+			free(opt.kpos);
+			ph_free_keys(opt.hkeys);
 			break;
 		}
 
-		case PHASHIST_CMD_PERF:;
-			phash_t sum;
+		case PHASHIST_CMD_PERF: {
+			const char *karg;
+			perfopt_t opt = {
+				.niter = 100U,
+				.cyc = PHCYC_NONE,
+				.cycfd = -1,
+			};
+
+			if (UNLIKELY(keys == NULL || keys->n == 0U)) {
+				break;
+			}
+			if ((karg = argi->perf.iterations_arg)) {
+				char *on;
+				long int n = strtol(karg, &on, 0);
 
-			/* performance */
-			sum = 0x94;
-			for (size_t j = 0U; j < 1000000U; j++) {
-				for (size_t i = 0U; i < keys->n; i++) {
-					phkey_t k = phvec_key(keys, i);
-					const size_t z = phvec_keylen(keys, i);
-					sum += phash(k, z, sum);
+				if (n <= 0 || *on) {
+					errno = 0, error("\
+Invalid argument to --iterations: `%s'\n\
+Valid values are integers >= 1", karg);
+					rc = 1;
+					break;
 				}
+				opt.niter = (size_t)n;
+			}
+			if (argi->perf.cycles_flag &&
+			    !(opt.cyc = perf_cycopen(&opt.cycfd))) {
+				errno = 0, error("\
+no cycle counter available");
+				rc = 1;
+				break;
+			}
+
+			printf("%-12s %10s %10s %10s %8s",
+			       "hash", "ns/hash", "p99", "Mhash/s", "GB/s");
+			if (opt.cyc) {
+				printf(" %10s %10s",
+				       opt.cyc == PHCYC_PERF
+				       ? "cyc/hash" : "tsc/hash", "p99");
+			}
+			putchar('\n');
+
+			for (phfun_t f = PHASH_UNK + 1; f < PHASH_NFUN; f++) {
+				const char *kn;
+
+				if (argi->hash_arg && !autop && f != get_phash()) {
+					/* just the one they asked for */
+					continue;
+				} else if (phash_kernel(f, 1U, &kn) == NULL) {
+					/* one implementation only */
+					ph_perf(keys, phash_name(f), phash_fun(f), &opt);
+					continue;
+				}
+				/* time every implementation */
+				for (unsigned int i = 0U; ; i++) {
+					char nm[32U];
+					phash_f hf;
+
+					if ((hf = phash_kernel(f, i, &kn)) == NULL) {
+						break;
+					}
+					snprintf(nm, sizeof(nm), "%s/%s",
+						 phash_name(f), kn);
+					ph_perf(keys, nm, hf, &opt);
+				}
+			}
+			if (opt.cycfd >= 0) {
+				close(opt.cycfd);
 			}
-			printf("sum %zx\n", sum);
 			break;
+		}
 
 		case PHASHIST_CMD_PRINT: {
 			phash_t msk = NIL_HASH;
@@ -777,8 +1967,9 @@ Valid values are integers >= 1", karg);
 				const size_t z = phvec_keylen(keys, i);
 				phash_t h = phash(k, z, 0U);
 
-				printf("%0*zx\t%s\n",
-				       (int)((n - 1U) / 4U + 1), h & msk, k);
+				printf("%0*zx\t", (int)((n - 1U) / 4U + 1), h & msk);
+				fwrite(k, 1, z, stdout);
+				putchar('\n');
 			}
 			break;
 		}
@@ -789,6 +1980,7 @@ Valid values are integers >= 1", karg);
 
 		ph_free_keys(keys);
 	}
+	ph_free_gperf(gp);
 
 out:
 	yuck_free(argi);
@@ -0,0 +1,103 @@
+/*** phashist.h -- perfect hash tables at runtime
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of phashist.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_phashist_h_
+#define INCLUDED_phashist_h_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif	/* __cplusplus */
+
+typedef struct ph_table_s *ph_table_t;
+
+typedef struct {
+	/* hash routine, as in phashist --hash, NULL for wy */
+	const char *hash;
+	/* construction, bob or chd, NULL for bob,
+	 * chd doesn't work with icke2, jsw or murmur */
+	const char *algo;
+	/* number of threads for the salt search, 0 is like 1 */
+	unsigned int njobs;
+} ph_opt_t;
+
+/* what ph_lookup() returns for strings that aren't keys */
+#define PH_NOTFOUND	((size_t)-1)
+
+
+/**
+ * Build a perfect hash table over the N keys KEYS of lengths LENS,
+ * LENS can be NULL if the keys are NUL-terminated, OPT can be NULL
+ * for the defaults.  The keys are copied.
+ * Return NULL and set errno if OPT is invalid (EINVAL), if there are
+ * duplicate keys or no table could be found (EEXIST) or if the keys
+ * don't fit into 4GB (EFBIG). */
+extern ph_table_t
+ph_build(const char *const *keys, const size_t *lens, size_t n,
+	 const ph_opt_t *opt);
+
+/**
+ * Open a table written by phashist build --format=bin, it's mapped
+ * read-only so processes that open the same file share its pages.
+ * Return NULL and set errno if the file can't be mapped or isn't a
+ * table of this version or was written where hash words have a
+ * different width (EINVAL).  Only the header is checked here,
+ * keys and payloads whose offsets are broken are treated as missing
+ * by ph_lookup() and ph_payload(). */
+extern ph_table_t ph_open(const char *fn);
+
+/**
+ * Return the index of KEY of length LEN in the keys TAB was built
+ * from or PH_NOTFOUND if it's not among them.
+ * Tables aren't modified by lookups, so they can be shared among
+ * threads. */
+extern size_t ph_lookup(ph_table_t tab, const char *key, size_t len);
+
+/**
+ * Return the payload of the I-th key of TAB, as given in the key file,
+ * or NULL if the keys came without or it's broken. */
+extern const char *ph_payload(ph_table_t tab, size_t i);
+
+/**
+ * Free resources associated with table TAB. */
+extern void ph_free(ph_table_t tab);
+
+#ifdef __cplusplus
+}
+#endif	/* __cplusplus */
+
+#endif	/* INCLUDED_phashist_h_ */
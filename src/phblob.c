@@ -0,0 +1,156 @@
+/*** phblob.c -- serialised perfect hash tables
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of phashist.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <endian.h>
+#include "nifty.h"
+#include "keys.h"
+#include "phfind.h"
+#include "phblob.h"
+
+#define ALIGN(x)	(((x) + PHBLOB_ALIGN - 1U) & ~(size_t)(PHBLOB_ALIGN - 1U))
+
+
+static inline void
+put32(uint8_t *b, size_t i, uint32_t x)
+{
+	x = htole32(x);
+	memcpy(b + i * sizeof(x), &x, sizeof(x));
+	return;
+}
+
+
+void*
+phblob_make(phtups_t tups, size_t *zp)
+{
+	const phvec_t keys = tups->keys;
+	const size_t n = keys->n;
+	phblob_hdr_t h = {
+		.version = PHBLOB_VERSION,
+		.hash = tups->hash,
+		.algo = tups->algo,
+		.nkeys = n,
+		.salt = tups->salt,
+		.alen = tups->alen,
+		.blen = tups->blen,
+		.smax = tups->smax,
+		.hbits = sizeof(phash_t) * CHAR_BIT,
+	};
+	size_t poolz = 0U;
+	size_t vpoolz = 0U;
+	size_t z;
+	uint8_t *res;
+
+	if (UNLIKELY(tups->pfx != NULL || tups->kpos != NULL || tups->k > 1U)) {
+		/* lookups would need more than one slot or key */
+		errno = ENOTSUP;
+		return NULL;
+	}
+	for (size_t i = 0U; i < n; i++) {
+		poolz += phvec_keylen(keys, i) + 1U;
+		if (keys->vals != NULL) {
+			vpoolz += strlen(keys->vals[i]) + 1U;
+		}
+	}
+	if (UNLIKELY(poolz >= UINT32_MAX || vpoolz >= UINT32_MAX)) {
+		errno = EFBIG;
+		return NULL;
+	}
+
+	/* lay out the sections */
+	z = ALIGN(sizeof(h));
+	h.tab = z;
+	z = ALIGN(z + tups->blen * sizeof(uint32_t));
+	h.kix = z;
+	z = ALIGN(z + tups->smax * sizeof(uint32_t));
+	h.koff = z;
+	z = ALIGN(z + (n + 1U) * sizeof(uint32_t));
+	h.pool = z;
+	z = ALIGN(z + poolz);
+	if (keys->vals != NULL) {
+		h.voff = z;
+		z = ALIGN(z + (n + 1U) * sizeof(uint32_t));
+		h.vpool = z;
+		z = ALIGN(z + vpoolz);
+	}
+	h.size = z;
+
+	if (UNLIKELY((res = calloc(z, 1U)) == NULL)) {
+		return NULL;
+	}
+	for (size_t b = 0U; b < tups->blen; b++) {
+		put32(res + h.tab, b, tups->bmap[b]);
+	}
+	for (size_t x = 0U; x < tups->smax; x++) {
+		put32(res + h.kix, x, n);
+	}
+	poolz = 0U;
+	vpoolz = 0U;
+	for (size_t i = 0U; i < n; i++) {
+		const size_t kz = phvec_keylen(keys, i);
+
+		put32(res + h.kix, phtups_slot(tups, i), i);
+		put32(res + h.koff, i, poolz);
+		memcpy(res + h.pool + poolz, phvec_key(keys, i), kz);
+		poolz += kz + 1U;
+		if (keys->vals != NULL) {
+			const size_t vz = strlen(keys->vals[i]);
+
+			put32(res + h.voff, i, vpoolz);
+			memcpy(res + h.vpool + vpoolz, keys->vals[i], vz);
+			vpoolz += vz + 1U;
+		}
+	}
+	put32(res + h.koff, n, poolz);
+	if (keys->vals != NULL) {
+		put32(res + h.voff, n, vpoolz);
+	}
+
+	memcpy(h.magic, PHBLOB_MAGIC, sizeof(h.magic));
+	phblob_hdr_swap(&h);
+	memcpy(res, &h, sizeof(h));
+	*zp = z;
+	return res;
+}
+
+/* phblob.c ends here */
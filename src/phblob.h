@@ -0,0 +1,117 @@
+/*** phblob.h -- serialised perfect hash tables
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of phashist.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_phblob_h_
+#define INCLUDED_phblob_h_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <endian.h>
+#include "phfind.h"
+
+/* blobs start with this, not NUL-terminated */
+#define PHBLOB_MAGIC	"phashist"
+/* bump this whenever the layout changes */
+#define PHBLOB_VERSION	(3U)
+/* sections start on cache line boundaries */
+#define PHBLOB_ALIGN	(64U)
+
+/* All fields and sections are little-endian, sections are arrays
+ * of uint32_t unless noted otherwise:
+ * tab[blen]    the tab[] of the generated code
+ * kix[smax]    index of the key in each slot, nkeys if vacant
+ * koff[nkeys + 1] offsets of the keys in pool[]
+ * pool         bytes, the keys each followed by a NUL
+ * voff[nkeys + 1], vpool  like koff and pool for payloads, optional */
+typedef struct {
+	uint8_t magic[8U];
+	uint32_t version;
+	/* phfun_t and phalgo_t */
+	uint32_t hash;
+	uint32_t algo;
+	uint32_t nkeys;
+	uint64_t salt;
+	uint32_t alen;
+	uint32_t blen;
+	uint32_t smax;
+	/* width of phash_t in bits when written, the salted hash routines
+	 * carry bits beyond PHASH_BITS so their words, and hence the slots,
+	 * differ among widths */
+	uint32_t hbits;
+	/* offsets of the sections from the start of the blob,
+	 * voff and vpool are 0 if there are no payloads */
+	uint64_t tab;
+	uint64_t kix;
+	uint64_t koff;
+	uint64_t pool;
+	uint64_t voff;
+	uint64_t vpool;
+	/* size of the whole blob */
+	uint64_t size;
+} phblob_hdr_t;
+
+
+/**
+ * Serialise TUPS into a blob, returned in malloc()'d memory, and put
+ * its size into *ZP.  Return NULL and set errno if TUPS is a prefix,
+ * key position or k-perfect table (ENOTSUP) or too big (EFBIG). */
+extern void *phblob_make(phtups_t tups, size_t *zp);
+
+
+static inline void
+phblob_hdr_swap(phblob_hdr_t *h)
+{
+/* convert H between host and little-endian order, both ways */
+	h->version = htole32(h->version);
+	h->hash = htole32(h->hash);
+	h->algo = htole32(h->algo);
+	h->nkeys = htole32(h->nkeys);
+	h->salt = htole64(h->salt);
+	h->alen = htole32(h->alen);
+	h->blen = htole32(h->blen);
+	h->smax = htole32(h->smax);
+	h->hbits = htole32(h->hbits);
+	h->tab = htole64(h->tab);
+	h->kix = htole64(h->kix);
+	h->koff = htole64(h->koff);
+	h->pool = htole64(h->pool);
+	h->voff = htole64(h->voff);
+	h->vpool = htole64(h->vpool);
+	h->size = htole64(h->size);
+	return;
+}
+
+#endif	/* INCLUDED_phblob_h_ */
@@ -0,0 +1,1067 @@
+/*** phfind.c -- finding perfect hash tables
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of phashist.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * This project incorporates ideas (and code) by Bob Jenkins.
+ ***/
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "nifty.h"
+#include "phfind.h"
+
+
+static __attribute__((format(printf, 2, 3))) void
+ph_diag(bool quietp, const char *fmt, ...)
+{
+/* report progress or trouble on stderr unless QUIETP */
+	va_list vap;
+
+	if (quietp) {
+		return;
+	}
+	va_start(vap, fmt);
+	vfprintf(stderr, fmt, vap);
+	va_end(vap);
+	fputc('\n', stderr);
+	return;
+}
+
+static void*
+recalloc(void *x, size_t ol_nmemb, size_t nu_nmemb, size_t membz)
+{
+	if (UNLIKELY((x = realloc(x, nu_nmemb * membz)) == NULL)) {
+		return NULL;
+	}
+	memset((char*)x + ol_nmemb * membz, 0, (nu_nmemb - ol_nmemb) * membz);
+	return x;
+}
+
+
+static phvec_stats_t
+phvec_stats(phvec_t kv)
+{
+	size_t min = -1UL, max = 0UL;
+	phvec_stats_t res;
+
+	if (UNLIKELY(kv->n == 0U)) {
+		return NULL;
+	}
+	for (size_t i = 0U; i < kv->n; i++) {
+		const size_t len = phvec_keylen(kv, i);
+
+		if (len < min) {
+			min = len;
+		}
+		if (len > max) {
+			max = len;
+		}
+	}
+
+	res = malloc(sizeof(*res) + (max - min + 1U) * sizeof(*res->lens));
+	res->min = min;
+	res->max = max;
+	memset(res->lens, 0, (max - min + 1U) * sizeof(*res->lens));
+	for (size_t i = 0U; i < kv->n; i++) {
+		const size_t kz = phvec_keylen(kv, i);
+
+		res->lens[kz - min]++;
+	}
+	return res;
+}
+
+static void
+phvec_free_stats(phvec_stats_t ks)
+{
+	if (UNLIKELY(ks == NULL)) {
+		return;
+	}
+	free(ks);
+	return;
+}
+
+static phvec_stats_t
+phvec_dup_stats(phvec_stats_t ks)
+{
+	phvec_stats_t res;
+	size_t z;
+
+	if (UNLIKELY(ks == NULL)) {
+		return NULL;
+	}
+	z = sizeof(*ks) + (ks->max - ks->min + 1U) * sizeof(*ks->lens);
+	res = malloc(z);
+	memcpy(res, ks, z);
+	return res;
+}
+
+
+
+static void
+guess_lengths(size_t *alen, size_t *blen, const size_t smax, const size_t nkeys)
+{
+/*
+ * Find initial *alen, *blen
+ * Initial alen and blen values were found empirically.  Some factors:
+ *
+ * If smax<256 there is no scramble, so tab[b] needs to cover 0..smax-1.
+ *
+ * alen and blen must be powers of 2 because the values in 0..alen-1 and
+ * 0..blen-1 are produced by applying a bitmask to the initial hash function.
+ *
+ * alen must be less than smax, in fact less than nkeys, because otherwise
+ * there would often be no i such that a^scramble[i] is in 0..nkeys-1 for
+ * all the *a*s associated with a given *b*, so there would be no legal
+ * value to assign to tab[b].  This only matters when we're doing a minimal
+ * perfect hash.
+ *
+ * It takes around 800 trials to find distinct (a,b) with nkey=smax*(5/8)
+ * and alen*blen = smax*smax/32.
+ *
+ * Values of blen less than smax/4 never work, and smax/2 always works.
+ *
+ * We want blen as small as possible because it is the number of bytes in
+ * the huge array we must create for the perfect hash.
+ *
+ * When nkey <= smax*(5/8), blen=smax/4 works much more often with
+ * alen=smax/8 than with alen=smax/4.  Above smax*(5/8), blen=smax/4
+ * doesn't seem to care whether alen=smax/8 or alen=smax/4.  I think it
+ * has something to do with 5/8 = 1/8 * 5.  For example examine 80000,
+ * 85000, and 90000 keys with different values of alen.  This only matters
+ * if we're doing a minimal perfect hash.
+ *
+ * When alen*blen <= 1<<UINT32_TBITS, the initial hash must produce one integer.
+ * Bigger than that it must produce two integers, which increases the
+ * cost of the hash per character hashed.
+ */
+	const double dnkeys = (double)nkeys;
+	const double dsmax = (double)smax;
+
+	*alen = smax;
+	if (0) {
+		;
+	} else if (smax / 4U <= (1 << 14U)) {
+		if (0) {
+			;
+		} else if (dnkeys <= dsmax * 0.56) {
+			*blen = smax / 32U;
+		} else if (dnkeys <= dsmax * 0.74) {
+			*blen = smax / 16U;
+		} else {
+			*blen = smax / 8U;
+		}
+	} else {
+		if (0) {
+			;
+		} else if (dnkeys <= dsmax * 0.6) {
+			*blen = smax / 16U;
+		} else if (dnkeys <= dsmax * 0.8) {
+			*blen = smax / 8U;
+		} else {
+			*blen = smax / 4U;
+		}
+	}
+	/* make 1 the minimum */
+	if (UNLIKELY(*alen < 1U)) {
+		*alen = 1U;
+	}
+	if (UNLIKELY(*blen < 1U)) {
+		*blen = 1U;
+	}
+	return;
+}
+
+static phtups_t
+make_tups(phvec_t keys, phcnt_t k, phfun_t hash)
+{
+	phtups_t res = malloc(sizeof(*res) + keys->n * sizeof(*res->tups));
+
+	res->algo = PHALGO_BOB;
+	res->hash = hash;
+	res->hf = phash_fun(hash);
+	res->hb = phash_batch_fun(hash);
+	res->keys = keys;
+	/* whole keys unless we're told otherwise */
+	res->hkeys = keys;
+	res->kpos = NULL;
+	/* guess initial values for smax, alen and blen */
+	res->smax = 1UL << xilogb(keys->n);
+	guess_lengths(&res->alen, &res->blen, res->smax, keys->n);
+	/* and some counters for the distribution of b-values */
+	res->bmap = malloc(res->blen * sizeof(*res->bmap));
+	/* not a prefix table unless we're told otherwise */
+	res->pfx = NULL;
+	/* scratch space is allocated lazily */
+	res->boff = NULL;
+	res->bord = malloc(keys->n * sizeof(*res->bord));
+	res->aref = NULL;
+	res->scrz_a = 0U;
+	res->scrz_b = 0U;
+	/* assign k-perfection value */
+	res->k = k;
+	res->quiet = false;
+	return res;
+}
+
+void
+free_tups(phtups_t ktups)
+{
+	free(ktups->bmap);
+	phvec_free_stats(ktups->pfx);
+	free(ktups->boff);
+	free(ktups->bord);
+	free(ktups->aref);
+	free(ktups);
+	return;
+}
+
+static phtups_t
+clone_tups(const phtups_t proto)
+{
+/* obtain scratch tuples with the same geometry as PROTO */
+	const phvec_t keys = proto->keys;
+	phtups_t res = malloc(sizeof(*res) + keys->n * sizeof(*res->tups));
+
+	res->algo = proto->algo;
+	res->hash = proto->hash;
+	res->hf = proto->hf;
+	res->hb = proto->hb;
+	res->keys = keys;
+	res->hkeys = proto->hkeys;
+	res->kpos = proto->kpos;
+	res->salt = 0U;
+	res->k = proto->k;
+	res->quiet = proto->quiet;
+	res->smax = proto->smax;
+	res->alen = proto->alen;
+	res->blen = proto->blen;
+	res->pfx = phvec_dup_stats(proto->pfx);
+	/* not needed for phtups_mktab() */
+	res->bmap = NULL;
+	res->boff = NULL;
+	res->bord = malloc(keys->n * sizeof(*res->bord));
+	res->aref = NULL;
+	res->scrz_a = 0U;
+	res->scrz_b = 0U;
+	return res;
+}
+
+phash2_t
+phtups_keyhash(phtups_t ktups, size_t i, phash_t ilev, bool hiwordp)
+{
+/* hash the I-th key starting with ILEV, the high word is only
+ * computed if HIWORDP */
+	const phvec_t keys = ktups->hkeys;
+	const phvec_stats_t pfx = ktups->pfx;
+	const phash_f hf = ktups->hf;
+	phkey_t k = phvec_key(keys, i);
+	size_t kz = phvec_keylen(keys, i);
+	phash2_t h;
+
+	if (LIKELY(pfx == NULL)) {
+		/* see phash2() */
+		h.lo = hf(k, kz, ilev);
+		h.hi = hiwordp ? phash_hi(k, kz, ~ilev) : 0U;
+		return h;
+	}
+	/* chain the hash through all key lengths up to KZ
+	 * so prefixes of a string can be hashed incrementally,
+	 * the chained value is mixed because hashes like icke2 merely
+	 * xor PREV into the result */
+	h.lo = ilev;
+	h.hi = ~ilev;
+	for (size_t l = pfx->min, o = 0U; l <= kz; l++) {
+		if (!pfx->lens[l - pfx->min]) {
+			continue;
+		} else if (o) {
+			h.lo = phash_mix(h.lo);
+			h.hi = hiwordp ? phash_mix(h.hi) : h.hi;
+		}
+		h.lo = hf(k + o, l - o, h.lo);
+		if (hiwordp) {
+			h.hi = phash_hi(k + o, l - o, h.hi);
+		}
+		o = l;
+	}
+	return h;
+}
+
+static void
+phtups_hashv(phtups_t ktups, size_t from, size_t to, phash_t ilev,
+	     phash_t *restrict lo, phash_t *restrict hi)
+{
+/* like phtups_keyhash() for keys FROM up to TO, storing the words in
+ * LO and HI, the high words are only computed if HI is non-NULL */
+	if (ktups->pfx != NULL) {
+		/* prefix chains are per key */
+		for (size_t i = from; i < to; i++) {
+			phash2_t h = phtups_keyhash(ktups, i, ilev, hi != NULL);
+
+			lo[i - from] = h.lo;
+			if (hi != NULL) {
+				hi[i - from] = h.hi;
+			}
+		}
+		return;
+	}
+	ktups->hb(ktups->hkeys, from, to, ilev, lo);
+	if (hi != NULL) {
+		/* see phash2() */
+		phash_hi_batch(ktups->hkeys, from, to, ~ilev, hi);
+	}
+	return;
+}
+
+static int
+phtups_phash(phtups_t ktups, phash_t salt)
+{
+/* this is Bob's initnorm() routine */
+#define PHASH_CHUNK	(256U)
+	const phcnt_t alog = xilogb(ktups->alen);
+	const phcnt_t blog = xilogb(ktups->blen);
+	const phvec_t keys = ktups->keys;
+	const phash_t ilev = salt_ilev(salt);
+	const bool hiwordp = phtups_hiwordp(ktups);
+	phash_t lo[PHASH_CHUNK];
+	phash_t hi[PHASH_CHUNK];
+
+	for (size_t i0 = 0U; i0 < keys->n; i0 += PHASH_CHUNK) {
+		const size_t nc = keys->n - i0 < PHASH_CHUNK
+			? keys->n - i0 : PHASH_CHUNK;
+		__typeof__(*ktups->tups) *tt = ktups->tups + i0;
+
+		phtups_hashv(ktups, i0, i0 + nc, ilev, lo, hiwordp ? hi : NULL);
+
+		if (ktups->algo == PHALGO_CHD) {
+			/* b is the bucket, a is the key's hash in the bucket */
+			for (size_t i = 0U; i < nc; i++) {
+				tt[i].a = hi[i];
+				tt[i].b = chd_bucket(lo[i], ktups->blen);
+			}
+		} else if (hiwordp) {
+			/* this is Bob's checksum() path,
+			 * draw a from the high word and b from the low word */
+			for (size_t i = 0U; i < nc; i++) {
+				tt[i].a = hi[i] & (ktups->alen - 1U);
+				tt[i].b = lo[i] & (ktups->blen - 1U);
+			}
+		} else {
+			for (size_t i = 0U; i < nc; i++) {
+				tt[i].a = alog
+					? (lo[i] >> blog) & (ktups->alen - 1U)
+					: 0U;
+				tt[i].b = blog
+					? lo[i] & (ktups->blen - 1U) : 0U;
+			}
+		}
+	}
+	return 0;
+}
+
+static void
+phtups_bsort(phtups_t tups)
+{
+/* counting sort of the keys by b-value, O(n + blen) */
+	const size_t nkeys = tups->keys->n;
+
+	if (UNLIKELY(tups->scrz_b < tups->blen)) {
+		const size_t nu = tups->blen;
+		tups->boff = realloc(tups->boff, (nu + 1U) * sizeof(*tups->boff));
+		tups->scrz_b = nu;
+	}
+
+	memset(tups->boff, 0, (tups->blen + 1U) * sizeof(*tups->boff));
+	for (size_t i = 0U; i < nkeys; i++) {
+		tups->boff[tups->tups[i].b + 1U]++;
+	}
+	for (size_t b = 0U; b < tups->blen; b++) {
+		tups->boff[b + 1U] += tups->boff[b];
+	}
+	/* distribute, this will advance boff[b] to the start of b + 1 */
+	for (size_t i = 0U; i < nkeys; i++) {
+		tups->bord[tups->boff[tups->tups[i].b]++] = i;
+	}
+	/* ... so shift them back */
+	for (size_t b = tups->blen; b > 0U; b--) {
+		tups->boff[b] = tups->boff[b - 1U];
+	}
+	tups->boff[0U] = 0U;
+	return;
+}
+
+static size_t
+phtups_mktab(phtups_t tups, bool thoroughp)
+{
+/* this is Bob's inittab()
+ * put keys in tabb according to key->b_k
+ * check if the initial hash might work,
+ * return the number of collisions
+ *
+ * Instead of comparing every key against every other key we sort
+ * the keys by b-value and then, within each b-group, look up a-values
+ * in a back reference array aref[] indexed by a, which makes this
+ * O(n + alen + blen) per salt. */
+	const phvec_t keys = tups->keys;
+	size_t ncoll = 0U;
+
+	if (UNLIKELY(tups->scrz_a < tups->alen)) {
+		const size_t ol = tups->scrz_a;
+		const size_t nu = tups->alen;
+		tups->aref = recalloc(tups->aref, ol, nu, sizeof(*tups->aref));
+		tups->scrz_a = nu;
+	}
+
+	phtups_bsort(tups);
+
+	/* two keys with the same (a,b) guarantee a collision */
+	for (size_t b = 0U; b < tups->blen; b++) {
+		const size_t beg = tups->boff[b];
+		const size_t end = tups->boff[b + 1U];
+
+		/* check a-values for this b-value */
+		for (size_t j = beg; j < end; j++) {
+			const size_t i = tups->bord[j];
+			const phash_t a = tups->tups[i].a;
+			/* stale references (from previous b-values or
+			 * previous salts) point outside [beg, j) or
+			 * refer to keys with different a-values */
+			const size_t r = tups->aref[a];
+
+			if (LIKELY(r < beg || r >= j) ||
+			    tups->tups[tups->bord[r]].a != a) {
+				/* first key with this (a,b) */
+				tups->aref[a] = j;
+				continue;
+			}
+			/* collision */
+			ncoll++;
+			if (!phvec_keycmp(keys, tups->bord[r], i)) {
+				/* grrr, we've got key dups */
+				ph_diag(tups->quiet, "\
+duplicate keys detected: line %zu  vs  line %zu  `%.*s'",
+				      tups->bord[r] + 1U, i + 1U,
+				      (int)phvec_keylen(keys, i),
+				      phvec_key(keys, i));
+			}
+			/* here we could break because
+			 * we already know there are collisions */
+			if (!thoroughp) {
+				goto out;
+			}
+		}
+	}
+out:
+	return ncoll;
+}
+
+static bool
+phtups_stuckp(phtups_t tups, phash_t salt)
+{
+/* return true if no salt can make (a,b) distinct in the current
+ * geometry, that is if (a,b) are the lowest bits of the low hash word
+ * and two keys with the same (a,b) under SALT will have the same (a,b)
+ * under every salt, see phash_salting() */
+	const phvec_t keys = tups->hkeys;
+	const phsalt_t how = phash_salting(tups->hash);
+
+	if (how == PHSALT_MIXED || phtups_widep(tups) || tups->pfx) {
+		return false;
+	}
+	phtups_phash(tups, salt);
+	if (phtups_mktab(tups, false) == 0U) {
+		return false;
+	} else if (how == PHSALT_XOR) {
+		return true;
+	}
+	/* phtups_mktab() has grouped the keys by b-value,
+	 * redo its a-value check for keys of the same length */
+	for (size_t b = 0U; b < tups->blen; b++) {
+		const size_t beg = tups->boff[b];
+		const size_t end = tups->boff[b + 1U];
+
+		for (size_t j = beg; j < end; j++) {
+			const size_t i = tups->bord[j];
+			const phash_t a = tups->tups[i].a;
+			const size_t r = tups->aref[a];
+
+			if (r < beg || r >= j ||
+			    tups->tups[tups->bord[r]].a != a) {
+				tups->aref[a] = j;
+			} else if (phvec_keylen(keys, tups->bord[r]) ==
+				   phvec_keylen(keys, i)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static size_t*
+phtups_gsort(phtups_t tups)
+{
+/* return the b-values sorted by group size, largest first,
+ * this is a counting sort on the group sizes in boff[],
+ * so phtups_bsort() must have been called before */
+	size_t *bsrt = malloc(tups->blen * sizeof(*bsrt));
+	size_t *bcnt;
+	size_t maxb = 0U;
+
+	for (size_t b = 0U; b < tups->blen; b++) {
+		const size_t m = tups->boff[b + 1U] - tups->boff[b];
+
+		if (m > maxb) {
+			maxb = m;
+		}
+	}
+	bcnt = calloc(maxb + 2U, sizeof(*bcnt));
+	for (size_t b = 0U; b < tups->blen; b++) {
+		const size_t m = tups->boff[b + 1U] - tups->boff[b];
+
+		bcnt[maxb - m + 1U]++;
+	}
+	for (size_t m = 0U; m <= maxb; m++) {
+		bcnt[m + 1U] += bcnt[m];
+	}
+	for (size_t b = 0U; b < tups->blen; b++) {
+		const size_t m = tups->boff[b + 1U] - tups->boff[b];
+
+		bsrt[bcnt[maxb - m]++] = b;
+	}
+	free(bcnt);
+	return bsrt;
+}
+
+/* find a mapping that makes this a perfect hash */
+static bool
+phtups_perfp(phtups_t tups)
+{
+/* greedy approach, place the b-groups largest first, for each group
+ * find the smallest displacement bmap[b] such that none of the slots
+ * a ^ bmap[b] is full yet, the slots of earlier groups are never
+ * touched again */
+	const size_t bmpz = tups->blen * sizeof(*tups->bmap);
+	const size_t smsk = tups->smax - 1U;
+	size_t *bsrt;
+	phcnt_t *xcnt;
+	bool res = true;
+
+	if (UNLIKELY(tups->bmap == NULL)) {
+		tups->bmap = malloc(bmpz);
+	} else {
+		tups->bmap = realloc(tups->bmap, bmpz);
+	}
+
+	/* rinse b-map */
+	memset(tups->bmap, 0, bmpz);
+
+	/* group keys by b-value */
+	phtups_bsort(tups);
+
+	/* largest groups first */
+	bsrt = phtups_gsort(tups);
+
+	/* generate the bitset (or counting set really) */
+	xcnt = calloc(tups->smax, sizeof(*xcnt));
+
+	for (size_t j = 0U; j < tups->blen; j++) {
+		const size_t b = bsrt[j];
+		const size_t beg = tups->boff[b];
+		const size_t end = tups->boff[b + 1U];
+		phash_t d;
+
+		if (beg == end) {
+			/* only empty groups from here on */
+			break;
+		}
+		for (d = 0U; d < tups->smax; d++) {
+			size_t i;
+
+			for (i = beg; i < end; i++) {
+				const size_t k = tups->bord[i];
+				const phash_t h = (tups->tups[k].a ^ d) & smsk;
+
+				if (xcnt[h]++ >= tups->k) {
+					/* include the one we've just bumped */
+					i++;
+					goto roll_back;
+				}
+			}
+			/* all keys of this group fit */
+			break;
+
+		roll_back:
+			/* undo this group's counts, try another bmap value */
+			while (i-- > beg) {
+				const size_t k = tups->bord[i];
+				const phash_t h = (tups->tups[k].a ^ d) & smsk;
+
+				xcnt[h]--;
+			}
+		}
+		if (UNLIKELY(d >= tups->smax)) {
+			goto fail;
+		}
+		tups->bmap[b] = d;
+	}
+
+	/* PERFICK, we found a perfect hash */
+out:
+	free(xcnt);
+	free(bsrt);
+	return res;
+
+fail:
+	ph_diag(tups->quiet, "\
+failed to map groups for tab size %zu", tups->blen);
+	res = false;
+	goto out;
+}
+
+struct scan_s {
+	phtups_t proto;
+	phash_t to;
+	/* next unclaimed salt and best salt so far, both atomic */
+	phash_t next;
+	phash_t best;
+};
+
+#define SCAN_CHUNK	(16U)
+
+static void*
+scan_worker(void *clo)
+{
+	struct scan_s *sc = clo;
+	phtups_t tups = clone_tups(sc->proto);
+
+	for (;;) {
+		const phash_t from =
+			__atomic_fetch_add(&sc->next, SCAN_CHUNK, __ATOMIC_RELAXED);
+		phash_t to = from + SCAN_CHUNK;
+
+		if (to > sc->to) {
+			to = sc->to;
+		}
+		for (phash_t s = from; s < to; s++) {
+			phash_t best = __atomic_load_n(&sc->best, __ATOMIC_RELAXED);
+
+			if (s >= best) {
+				/* someone else found a lower salt */
+				goto out;
+			}
+			phtups_phash(tups, s);
+			if (phtups_mktab(tups, false) > 0U) {
+				continue;
+			}
+			/* found one, see if it's the lowest */
+			while (s < best &&
+			       !__atomic_compare_exchange_n(
+				       &sc->best, &best, s, false,
+				       __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+			goto out;
+		}
+		if (to >= sc->to) {
+			break;
+		}
+	}
+out:
+	free_tups(tups);
+	return NULL;
+}
+
+static phash_t
+phtups_scan(phtups_t tups, phash_t from, phash_t to, unsigned int njobs)
+{
+/* return the lowest salt in [FROM, TO) that produces distinct (a,b)
+ * or TO if there is no such salt,
+ * the tuples in TUPS are unspecified afterwards
+ * With NJOBS > 1, worker threads claim chunks of salts and stop once
+ * a salt lower than anything they could still find is known, the
+ * result is the same as for the sequential search. */
+	if (njobs <= 1U) {
+		for (phash_t s = from; s < to; s++) {
+			phtups_phash(tups, s);
+			if (phtups_mktab(tups, false) == 0U) {
+				return s;
+			}
+		}
+		return to;
+	}
+
+	struct scan_s sc = {tups, to, from, to};
+	pthread_t *th;
+	unsigned int nth = 0U;
+
+	/* more threads than chunks would idle */
+	if (njobs > (to - from + SCAN_CHUNK - 1U) / SCAN_CHUNK) {
+		njobs = (to - from + SCAN_CHUNK - 1U) / SCAN_CHUNK;
+	}
+	if (LIKELY((th = malloc(njobs * sizeof(*th))) != NULL)) {
+		for (; nth < njobs; nth++) {
+			if (pthread_create(th + nth, NULL, scan_worker, &sc)) {
+				break;
+			}
+		}
+	}
+	if (UNLIKELY(nth == 0U)) {
+		/* do it ourselves then */
+		scan_worker(&sc);
+	}
+	for (unsigned int i = 0U; i < nth; i++) {
+		pthread_join(th[i], NULL);
+	}
+	free(th);
+	return sc.best;
+}
+
+static phtups_t
+ph_find_bob(phvec_t keys, const phopt_t *opt)
+{
+/* try and find a perfect hash function
+ * return the successful initializer for the initial hash.
+ * return 0 if no perfect hash could be found. */
+	size_t alen_max;
+
+	/* how many times did phvec_phash() fail */
+	phcnt_t badk = 0U;
+	/* how many times did phvec_mkperf() fail */
+	phcnt_t badp;
+	phtups_t res = make_tups(keys, opt->k, opt->hash);
+
+	/* more init'ting (could go into make_tups() really */
+	res->quiet = opt->quiet;
+	if (opt->prefix) {
+		res->pfx = phvec_stats(keys);
+	}
+	if (opt->kpos != NULL) {
+		res->kpos = opt->kpos;
+		res->hkeys = opt->hkeys;
+	}
+	alen_max = res->smax;
+
+	/* actually find the hash now */
+	badk = 0U;
+	badp = 0U;
+	for (phash_t trysalt = 1U; ;) {
+#define RETRY_MKTAB	(4096U)
+		/* try and find distinct tuples (a,b) for all keys
+		 * among the salts we're still allowed to try */
+		const phash_t endsalt = trysalt + (RETRY_MKTAB - badk);
+		const phash_t s = !phtups_stuckp(res, trysalt)
+			? phtups_scan(res, trysalt, endsalt, opt->njobs)
+			/* pretend we've tried them all */
+			: endsalt;
+
+		if (s >= endsalt) {
+			/* didn't find distinct (a,b) */
+			if (0) {
+				;
+				/* try and put more bits in (a,b)
+				 * to make distinct (a,b) more likely */
+			} else if (res->alen < alen_max) {
+				res->alen *= 2U;
+			} else if (res->blen < res->smax) {
+				res->blen *= 2U;
+			} else {
+				/* we're fucked, count the collisions */
+				phtups_phash(res, endsalt - 1U);
+				ph_diag(res->quiet, "\
+fatal error: cannot find perfect hash, still %zu collisions",
+						 phtups_mktab(res, true));
+				goto fail;
+			}
+			/* reset and try with larger alen/blen */
+			trysalt = endsalt;
+			badk = 0U;
+			badp = 0U;
+			continue;
+		}
+
+		/* all salts before S had collisions */
+		badk += s - trysalt;
+		trysalt = s;
+		/* get the tuples back for S */
+		phtups_phash(res, s);
+
+		if (!phtups_perfp(res)) {
+			/* no collisions, but not perfect either */
+#define RETRY_PERFP	(1U)
+			if (++badp < RETRY_PERFP) {
+				trysalt++;
+				continue;
+			} else if (res->blen < res->smax) {
+				res->blen *= 2U;
+
+				/* we know this salt got us perfectly
+				 * distinct (a,b), so don't advance */
+			} else if (res->smax <= 4U * alen_max) {
+				res->smax *= 2U;
+
+				/* we know this salt got us perfectly
+				 * distinct (a,b), so don't advance */
+			} else {
+				ph_diag(res->quiet, "\
+fatal error: cannot perfect hash");
+				goto fail;
+			}
+			/* reset badp counter, new salt new luck */
+			badp = 0U;
+		} else {
+			/* yay!!! we've got it */
+			res->salt = trysalt;
+			break;
+		}
+	}
+	ph_diag(res->quiet, "built perfect hash table of size %zu", res->blen);
+	return res;
+
+fail:
+	free_tups(res);
+	return NULL;
+}
+
+static bool
+phtups_chdp(phtups_t tups, phash_t dmax, bool *dupp)
+{
+/* CHD's placement, much like phtups_perfp() except that displacements
+ * step through 0..smax-1 by means of chd_slot() and we give up after
+ * DMAX displacements per bucket, return true if all buckets could be
+ * placed, set *DUPP if that failed because of duplicate keys */
+	const phvec_t keys = tups->keys;
+	const size_t nwrd = (tups->smax + 63U) / 64U;
+	uint64_t *occ;
+	size_t *bsrt;
+	bool res = true;
+
+	phtups_bsort(tups);
+	bsrt = phtups_gsort(tups);
+	occ = calloc(nwrd, sizeof(*occ));
+
+	for (size_t j = 0U; j < tups->blen; j++) {
+		const size_t b = bsrt[j];
+		const size_t beg = tups->boff[b];
+		const size_t end = tups->boff[b + 1U];
+		phash_t d;
+
+		if (beg == end) {
+			/* only empty buckets from here on */
+			for (; j < tups->blen; j++) {
+				tups->bmap[bsrt[j]] = 0U;
+			}
+			break;
+		}
+		for (d = 0U; d < dmax; d++) {
+			size_t i;
+
+			for (i = beg; i < end; i++) {
+				const size_t k = tups->bord[i];
+				const phash_t h = chd_slot(tups->tups[k].a, d, tups->smax);
+				const uint64_t m = 1ULL << (h % 64U);
+
+				if (occ[h / 64U] & m) {
+					goto roll_back;
+				}
+				occ[h / 64U] |= m;
+			}
+			/* all keys of this bucket fit */
+			break;
+
+		roll_back:
+			/* undo this bucket's slots, try another displacement */
+			while (i-- > beg) {
+				const size_t k = tups->bord[i];
+				const phash_t h = chd_slot(tups->tups[k].a, d, tups->smax);
+
+				occ[h / 64U] &= ~(1ULL << (h % 64U));
+			}
+		}
+		if (UNLIKELY(d >= dmax)) {
+			/* see if it's our fault or the user's */
+			for (size_t i = beg; i < end; i++) {
+				for (size_t k = i + 1U; k < end; k++) {
+					const size_t ki = tups->bord[i];
+					const size_t kk = tups->bord[k];
+
+					if (tups->tups[ki].a != tups->tups[kk].a) {
+						continue;
+					} else if (phvec_keycmp(keys, ki, kk)) {
+						continue;
+					}
+					ph_diag(tups->quiet, "\
+duplicate keys detected: line %zu  vs  line %zu  `%.*s'",
+					      ki + 1U, kk + 1U,
+					      (int)phvec_keylen(keys, ki),
+					      phvec_key(keys, ki));
+					*dupp = true;
+				}
+			}
+			res = false;
+			break;
+		}
+		tups->bmap[b] = d;
+	}
+
+	free(occ);
+	free(bsrt);
+	return res;
+}
+
+/* average number of keys per bucket */
+#define CHD_LAMBDA	(4U)
+/* load factor in percent */
+#define CHD_LOAD	(90U)
+/* displacements per bucket to try */
+#define CHD_DMAX	(0x10000U)
+
+size_t
+chd_nexc(phtups_t tups)
+{
+/* return the number of buckets with out-of-line displacements */
+	size_t nexc = 0U;
+
+	for (size_t b = 0U; b < tups->blen; b++) {
+		nexc += tups->bmap[b] >= CHD_DEXC;
+	}
+	return nexc;
+}
+
+static phtups_t
+ph_find_chd(phvec_t keys, const phopt_t *opt)
+{
+/* find a hash function using compress, hash and displace,
+ * this is Belazzougui, Botelho and Dietzfelbinger's algorithm with
+ * single-step displacements, most displacements fit into a byte and
+ * the rest is stored separately, see ph_genc_chd(), so tab[] costs
+ * a bit more than 8 / CHD_LAMBDA bits per key */
+	phtups_t res = make_tups(keys, 1U, opt->hash);
+	bool dupp = false;
+
+	res->algo = PHALGO_CHD;
+	res->alen = 0U;
+	res->blen = (keys->n + CHD_LAMBDA - 1U) / CHD_LAMBDA ?: 1U;
+	res->smax = (keys->n * 100U + CHD_LOAD - 1U) / CHD_LOAD ?: 1U;
+	res->bmap = realloc(res->bmap, res->blen * sizeof(*res->bmap));
+	res->quiet = opt->quiet;
+	if (opt->prefix) {
+		res->pfx = phvec_stats(keys);
+	}
+	if (opt->kpos != NULL) {
+		res->kpos = opt->kpos;
+		res->hkeys = opt->hkeys;
+	}
+
+	for (phash_t trysalt = 1U; ; trysalt++) {
+		phtups_phash(res, trysalt);
+
+		if (phtups_chdp(res, CHD_DMAX, &dupp)) {
+			/* yay!!! we've got it */
+			res->salt = trysalt;
+			break;
+		} else if (dupp) {
+			goto fail;
+		}
+#define RETRY_CHD	(16U)
+		if (trysalt >= RETRY_CHD) {
+			ph_diag(res->quiet, "\
+fatal error: cannot find displacements for %zu buckets", res->blen);
+			goto fail;
+		}
+	}
+	with (const size_t nexc = chd_nexc(res)) {
+		const double nbits = (double)(res->blen * 8U + nexc * 48U);
+
+		ph_diag(res->quiet, "\
+built perfect hash table with %zu buckets for %zu slots, %.2f bits/key",
+				 res->blen, res->smax, nbits / (double)keys->n);
+	}
+	return res;
+
+fail:
+	free_tups(res);
+	return NULL;
+}
+
+phtups_t
+ph_find(phvec_t keys, const phopt_t *opt)
+{
+	switch (opt->algo) {
+	case PHALGO_BOB:
+		return ph_find_bob(keys, opt);
+	case PHALGO_CHD:
+		if (opt->k > 1U) {
+			ph_diag(opt->quiet, "\
+k-perfect hash tables cannot be built with CHD");
+			return NULL;
+		} else if (phash_salting(opt->hash) != PHSALT_MIXED) {
+			/* keys with the same low word share a bucket under
+			 * every salt, one big bucket and we'd never be done */
+			ph_diag(opt->quiet, "\
+CHD tables cannot be built with hash %s", phash_name(opt->hash));
+			return NULL;
+		}
+		return ph_find_chd(keys, opt);
+	default:
+		break;
+	}
+	return NULL;
+}
+
+phash_t
+phtups_slot(phtups_t tups, size_t i)
+{
+/* return the slot of the I-th key */
+	const phash_t a = tups->tups[i].a;
+	const phash_t b = tups->tups[i].b;
+
+	switch (tups->algo) {
+	case PHALGO_CHD:
+		return chd_slot(a, tups->bmap[b], tups->smax);
+	case PHALGO_BOB:
+	default:
+		break;
+	}
+	return (a ^ tups->bmap[b]) & (tups->smax - 1U);
+}
+
+
+/* phfind.c ends here */
@@ -0,0 +1,215 @@
+/*** phfind.h -- finding perfect hash tables
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of phashist.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_phfind_h_
+#define INCLUDED_phfind_h_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "keys.h"
+#include "gperf.h"
+#include "phash.h"
+
+typedef struct {
+	size_t min;
+	size_t max;
+	phcnt_t lens[];
+} *phvec_stats_t;
+
+typedef struct {
+	size_t n;
+	/* offsets from the beginning of the key if >= 0,
+	 * from the end if < 0, i.e. -1 is the last byte */
+	int pos[];
+} *phkpos_t;
+
+typedef enum {
+	/* Bob's (a,b) + tab[] scheme */
+	PHALGO_BOB,
+	/* compress, hash and displace */
+	PHALGO_CHD,
+} phalgo_t;
+
+typedef enum {
+	/* an array of pointers to the keys */
+	PHLAYOUT_PTR,
+	/* one string of all keys and offsets into it */
+	PHLAYOUT_POOL,
+	/* fixed size slots with short keys inline */
+	PHLAYOUT_INLINE,
+} phlayout_t;
+
+typedef struct {
+	phalgo_t algo;
+	/* hash routine to build the table with */
+	phfun_t hash;
+	/* for k-perfect hashes */
+	phcnt_t k;
+	/* number of threads for the salt search */
+	unsigned int njobs;
+	/* map keys onto 0..n-1 */
+	bool minimal;
+	/* hash keys so that prefixes can be looked up */
+	bool prefix;
+	/* only hash the bytes at these key positions and the length,
+	 * HKEYS are the keys as the hash sees them, see phvec_gather() */
+	phkpos_t kpos;
+	phvec_t hkeys;
+	/* declarations and code if the keys come from a gperf file */
+	phgperf_t gperf;
+	/* how to lay out the keys in the emitted table */
+	phlayout_t layout;
+	/* C type of the keys' values, NULL if they come without */
+	const char *vtype;
+	/* don't report progress and failures on stderr */
+	bool quiet;
+} phopt_t;
+
+typedef struct {
+	phalgo_t algo;
+	phfun_t hash;
+	phash_f hf;
+	phash_batch_f hb;
+	phvec_t keys;
+	/* the keys as seen by the hash routine, KEYS unless the table
+	 * is built over key positions KPOS, both belong to phopt_t */
+	phvec_t hkeys;
+	phkpos_t kpos;
+	phash_t salt;
+	/* for k-perfect hashes */
+	phcnt_t k;
+	bool quiet;
+	size_t smax;
+	size_t alen;
+	size_t blen;
+	phash_t *bmap;
+	/* for prefix tables, the key length histogram, the hash of a key
+	 * is chained through all key lengths up to the key's length */
+	phvec_stats_t pfx;
+
+	/* scratch space for phtups_mktab(),
+	 * boff[b]..boff[b + 1] is the range in bord[] of keys with b-value b
+	 * aref[a] is a back reference into bord[] for a-value a */
+	size_t *boff;
+	size_t *bord;
+	size_t *aref;
+	size_t scrz_a;
+	size_t scrz_b;
+
+	struct {
+		phash_t a;
+		phash_t b;
+	} tups[];
+} *phtups_t;
+
+/* displacements at least this big are stored out of line */
+#define CHD_DEXC	(0xffU)
+
+
+/**
+ * Find a perfect hash table for KEYS as per OPT, return NULL if there
+ * is none or KEYS has duplicates. */
+extern phtups_t ph_find(phvec_t keys, const phopt_t *opt);
+
+/**
+ * Free a table obtained through ph_find(). */
+extern void free_tups(phtups_t tups);
+
+/**
+ * Return the slot of the I-th key in TUPS. */
+extern phash_t phtups_slot(phtups_t tups, size_t i);
+
+/**
+ * Return the hash words of the I-th key in TUPS starting with ILEV,
+ * the high word is only computed if HIWORDP. */
+extern phash2_t
+phtups_keyhash(phtups_t tups, size_t i, phash_t ilev, bool hiwordp);
+
+/**
+ * Return the number of CHD buckets with out-of-line displacements. */
+extern size_t chd_nexc(phtups_t tups);
+
+
+static inline phcnt_t
+xilogb(size_t n)
+{
+	phcnt_t i;
+	for (i = 0U; 1U << i < n; i++);
+	return i;
+}
+
+static inline bool
+phtups_widep(phtups_t ktups)
+{
+/* return true if (a,b) needs more bits than one hash word provides */
+	return xilogb(ktups->alen) + xilogb(ktups->blen) > PHASH_BITS;
+}
+
+static inline bool
+phtups_hiwordp(phtups_t ktups)
+{
+/* return true if slots are derived from both words of phash2() */
+	return ktups->algo == PHALGO_CHD || phtups_widep(ktups);
+}
+
+static inline phash_t
+salt_ilev(phash_t salt)
+{
+/* initial hash value for SALT, the generated code computes this in
+ * 32 bits, so we do the same */
+	return (salt * 0x9e3779b9U) & 0xffffffffU;
+}
+
+static inline phash_t
+chd_bucket(phash_t lo, size_t blen)
+{
+/* map the low hash word onto 0..BLEN-1 */
+	return ((uint_fast64_t)(lo & 0xffffffffU) * blen) >> 32U;
+}
+
+static inline phash_t
+chd_slot(phash_t f1, phash_t d, size_t smax)
+{
+/* map the high hash word F1, displaced by D, onto 0..SMAX-1,
+ * the step F2 is derived from F1 and is odd */
+	const phash_t f2 = phash_mix(f1) | 1U;
+	const uint_fast64_t x = (f1 + d * f2) & 0xffffffffU;
+
+	return (x * smax) >> 32U;
+}
+
+#endif	/* INCLUDED_phfind_h_ */
@@ -0,0 +1,31 @@
+#!/bin/sh
+## build a table from gperf input, its epilogue looks up every keyword
+## and checks the struct fields, then check that broken input is refused
+gen="gperf-gen.c"
+bad="gperf-bad.gperf"
+
+"${PHASHIST}" build "${srcdir}/ops.gperf" > "${gen}" 2>/dev/null || \
+	{ echo "ops.gperf: no table"; exit 1; }
+${CC} ${CFLAGS} -o gperf-bin "${gen}" || exit 1
+./gperf-bin || exit 1
+
+## refused() FILE MESSAGE, building from FILE must fail with MESSAGE
+refused()
+{
+	msg=$("${PHASHIST}" build "${1}" 2>&1 > /dev/null) && \
+		{ echo "${1}: table built"; return 1; }
+	case "${msg}" in
+	(*"${2}"*)
+		;;
+	(*)
+		echo "${1}: \`${msg}' instead of \`${2}'"
+		return 1
+		;;
+	esac
+}
+
+printf '%%%%\nfoo\n"bar\nbaz\n' > "${bad}"
+refused "${bad}" "${bad}:3: unterminated string" || exit 1
+printf 'foo\nbar\n' > "${bad}"
+refused "${bad}" "no %% line" || exit 1
+rm -f -- "${gen}" "${bad}" gperf-bin
@@ -0,0 +1,253 @@
+/*** lookup.c -- look up keys and non-keys in emitted tables
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of phashist.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+/* the code emitted by phashist build */
+#include PH_GEN
+
+static char **keys;
+static size_t nkeys;
+/* strings to look up and their lengths */
+static char **prbs;
+static size_t *lens;
+static size_t nprbs;
+
+static int
+kcmp(const void *x, const void *y)
+{
+	return strcmp(*(char *const*)x, *(char *const*)y);
+}
+
+static bool
+keyp(const char *s, size_t z)
+{
+/* S is NUL-terminated, keys are sorted and free of NULs */
+	return strlen(s) == z &&
+		bsearch(&s, keys, nkeys, sizeof(*keys), kcmp) != NULL;
+}
+
+static int
+check(const char *s, size_t z, const char *r)
+{
+/* R is what hash() gave for S, it must be S itself if that's a key
+ * and NULL otherwise */
+	if (keyp(s, z)) {
+		if (r == NULL || strlen(r) != z || memcmp(r, s, z)) {
+			fprintf(stderr, "key `%.*s' not found\n", (int)z, s);
+			return 1;
+		}
+	} else if (r != NULL) {
+		fprintf(stderr, "non-key `%.*s' found as `%s'\n",
+			(int)z, s, r);
+		return 1;
+	}
+	return 0;
+}
+
+#if defined PH_PREFIX
+static int
+check_prefix(const char *s, size_t z, const char *r)
+{
+/* R is what hash_prefix() gave for S, it must be the longest key that
+ * is a prefix of S and NULL if there's none */
+	char p[256U];
+	size_t l;
+
+	memcpy(p, s, z);
+	for (l = z; l > 0U; l--) {
+		p[l] = '\0';
+		if (keyp(p, l)) {
+			break;
+		}
+	}
+	if (!l) {
+		if (r != NULL) {
+			fprintf(stderr, "`%.*s' has a key prefix `%s'\n",
+				(int)z, s, r);
+			return 1;
+		}
+	} else if (r == NULL || strlen(r) != l || memcmp(r, s, l)) {
+		fprintf(stderr, "`%.*s' has the key prefix `%.*s' not `%s'\n",
+			(int)z, s, (int)l, s, r ? r : "(null)");
+		return 1;
+	}
+	return 0;
+}
+#endif	/* PH_PREFIX */
+
+#if defined PH_VALUE
+static int
+check_value(const char *s, size_t z, long int v)
+{
+/* V is what hash_value() gave for S, it must be the value of S in the
+ * key file if that's a key and PH_NOVALUE otherwise */
+	char *const *k = strlen(s) == z
+		? bsearch(&s, keys, nkeys, sizeof(*keys), kcmp) : NULL;
+	/* values are kept behind the key's NUL */
+	const char *kv = k != NULL ? *k + z + 1U : "";
+	const long int x = *kv ? strtol(kv, NULL, 0) : (long int)PH_NOVALUE;
+
+	if (v != x) {
+		fprintf(stderr, "value of `%.*s' is %ld, expected %ld\n",
+			(int)z, s, v, x);
+		return 1;
+	}
+	return 0;
+}
+#endif	/* PH_VALUE */
+
+static void
+probe(const char *s, size_t z)
+{
+/* remember S of length Z for a lookup */
+	prbs = realloc(prbs, (nprbs + 1U) * sizeof(*prbs));
+	lens = realloc(lens, (nprbs + 1U) * sizeof(*lens));
+	prbs[nprbs] = malloc(z + 1U);
+	memcpy(prbs[nprbs], s, z);
+	prbs[nprbs][z] = '\0';
+	lens[nprbs++] = z;
+	return;
+}
+
+#if defined PH_BATCH
+static int
+batch(void)
+{
+/* look up all probes at once, batches must agree with single lookups */
+	const char **out = malloc(nprbs * sizeof(*out));
+	int rc = 0;
+
+	hash_batch((const char *const*)prbs, lens, nprbs, out);
+	for (size_t i = 0U; i < nprbs; i++) {
+		if (out[i] != hash(prbs[i], lens[i])) {
+			fprintf(stderr, "batch lookup of `%s' differs\n",
+				prbs[i]);
+			rc = 1;
+		}
+	}
+	free(out);
+	return rc;
+}
+#endif	/* PH_BATCH */
+
+int
+main(int argc, char *argv[])
+{
+	char ln[256U];
+	FILE *f;
+	int rc = 0;
+
+	if (argc < 2 || (f = fopen(argv[1], "r")) == NULL) {
+		return 1;
+	}
+	while (fgets(ln, sizeof(ln), f) != NULL) {
+		const size_t z = strcspn(ln, "\n");
+
+		ln[z] = '\0';
+#if defined PH_VALUE
+		/* lines are KEY<TAB>VALUE, the value stays behind the key */
+		ln[strcspn(ln, "\t")] = '\0';
+#endif	/* PH_VALUE */
+		keys = realloc(keys, (nkeys + 1U) * sizeof(*keys));
+		keys[nkeys] = malloc(z + 2U);
+		memcpy(keys[nkeys], ln, z + 1U);
+		keys[nkeys++][z + 1U] = '\0';
+	}
+	fclose(f);
+	qsort(keys, nkeys, sizeof(*keys), kcmp);
+
+	for (size_t i = 0U; i < nkeys; i++) {
+		const size_t z = strlen(keys[i]);
+#if defined PH_PREFIX
+		size_t kz;
+#endif	/* PH_PREFIX */
+
+		memcpy(ln, keys[i], z + 1U);
+		probe(ln, z);
+		/* one byte less, one byte more, one byte changed */
+		probe(ln, z - 1U);
+		ln[z] = 'x';
+		probe(ln, z + 1U);
+		ln[z] = '\0';
+		ln[z / 2U] ^= 0x01;
+		probe(ln, z);
+#if defined PH_PREFIX
+		/* keys followed by junk or by the next key */
+		memcpy(ln, keys[i], z);
+		memcpy(ln + z, "\x7f#", 3U);
+		probe(ln, z + 2U);
+		if ((kz = strlen(keys[(i + 1U) % nkeys])) < sizeof(ln) - z) {
+			memcpy(ln + z, keys[(i + 1U) % nkeys], kz);
+			probe(ln, z + kz);
+		}
+#endif	/* PH_PREFIX */
+	}
+	probe("", 0U);
+#if defined PH_PREFIX
+	probe("\x7f#", 2U);
+#endif	/* PH_PREFIX */
+
+	for (size_t i = 0U; i < nprbs; i++) {
+		rc |= check(prbs[i], lens[i], hash(prbs[i], lens[i]));
+#if defined PH_PREFIX
+		rc |= check_prefix(prbs[i], lens[i],
+				   hash_prefix(prbs[i], lens[i]));
+#endif	/* PH_PREFIX */
+#if defined PH_VALUE
+		rc |= check_value(prbs[i], lens[i],
+				  hash_value(prbs[i], lens[i]));
+#endif	/* PH_VALUE */
+	}
+#if defined PH_BATCH
+	rc |= batch();
+#endif	/* PH_BATCH */
+
+	for (size_t i = 0U; i < nkeys; i++) {
+		free(keys[i]);
+	}
+	for (size_t i = 0U; i < nprbs; i++) {
+		free(prbs[i]);
+	}
+	free(keys);
+	free(prbs);
+	free(lens);
+	return rc;
+}
+
+/* lookup.c ends here */
@@ -0,0 +1,96 @@
+#!/bin/sh
+## compile the tables emitted for various build options and check that
+## hash() finds every key and nothing else, that hash_batch(), if
+## emitted, agrees with hash(), that hash_prefix(), if emitted, finds
+## the longest key prefix and that hash_value(), if emitted, finds the
+## values
+gen="lookup-gen.c"
+## extra flags for compiling the tables
+xflags=""
+
+lookup()
+{
+	case "${1}" in
+	(*/*)
+		keys="${1}"
+		;;
+	(*)
+		keys="${srcdir}/${1}"
+		;;
+	esac
+	shift
+	"${PHASHIST}" build "$@" "${keys}" > "${gen}" 2>/dev/null || \
+		{ echo "$*: no table"; return 1; }
+	${CC} ${CFLAGS} ${xflags} -I. -DPH_GEN="\"${gen}\"" \
+		-o lookup-bin "${srcdir}/lookup.c" || return 1
+	./lookup-bin "${keys}" || { echo "$*"; return 1; }
+}
+
+for h in bob icke2 wy; do
+	lookup ckw.txt --hash="${h}" || exit 1
+	lookup ckw.txt --hash="${h}" --minimal || exit 1
+done
+for h in bob oat wy; do
+	lookup ckw.txt --hash="${h}" --algo=chd || exit 1
+done
+lookup ckw.txt --algo=chd || exit 1
+"${PHASHIST}" build --algo=xyz "${srcdir}/ckw.txt" > /dev/null 2>&1 && \
+	{ echo "--algo=xyz accepted"; exit 1; }
+## CHD needs the salt to move keys between buckets
+for h in icke2 jsw murmur; do
+	"${PHASHIST}" build --hash="${h}" --algo=chd "${srcdir}/ckw.txt" \
+		> /dev/null 2>&1 && { echo "--algo=chd --hash=${h}"; exit 1; }
+done
+## --hash=auto tries every routine and keeps one of them
+lookup ckw.txt --hash=auto || exit 1
+lookup gnukw.txt --hash=auto --algo=chd || exit 1
+lookup lens.txt --hash=auto --minimal || exit 1
+"${PHASHIST}" build --hash=auto "${srcdir}/ckw.txt" 2>&1 > /dev/null | \
+	grep -q "using hash" || { echo "--hash=auto: no hash picked"; exit 1; }
+"${PHASHIST}" print --hash=auto "${srcdir}/ckw.txt" > /dev/null 2>&1 && \
+	{ echo "print --hash=auto accepted"; exit 1; }
+lookup ckw.txt --key-positions || exit 1
+lookup lens.txt --hash=wy || exit 1
+lookup lens.txt --hash=wy --algo=chd --minimal || exit 1
+for l in pool inline; do
+	lookup ckw.txt --layout="${l}" || exit 1
+	lookup gnukw.txt --layout="${l}" --hash=bob || exit 1
+	lookup gnukw.txt --layout="${l}" --hash=wy --algo=chd || exit 1
+	lookup gnukw.txt --layout="${l}" --hash=wy --minimal || exit 1
+	lookup gnukw.txt --layout="${l}" --key-positions || exit 1
+	lookup lens.txt --layout="${l}" --hash=wy || exit 1
+	lookup lens.txt --layout="${l}" --hash=wy --algo=chd --minimal || \
+		exit 1
+done
+"${PHASHIST}" build --layout=xyz "${srcdir}/ckw.txt" > /dev/null 2>&1 && \
+	{ echo "--layout=xyz accepted"; exit 1; }
+## hash_prefix() finds the longest key that is a prefix
+xflags="-DPH_PREFIX"
+for l in ptr pool inline; do
+	lookup ckw.txt --prefix --layout="${l}" || exit 1
+	lookup gnukw.txt --prefix --layout="${l}" --hash=bob || exit 1
+	lookup lens.txt --prefix --layout="${l}" --hash=wy --algo=chd || exit 1
+done
+xflags=""
+## hash_value() returns the values of keys, PH_NOVALUE for the rest
+xflags="-DPH_VALUE -DPH_NOVALUE=-1"
+lookup ckv.txt --value-type=int || exit 1
+lookup ckv.txt --value-type=int --minimal || exit 1
+lookup ckv.txt --value-type=int --key-positions || exit 1
+lookup ckv.txt --value-type=int --layout=pool --hash=bob || exit 1
+lookup ckv.txt --value-type=int --layout=inline --algo=chd || exit 1
+xflags=""
+## more keys than (a,b) can tell apart in one hash word
+awk 'BEGIN {
+	for (i = 0; i < 70000; i++) printf "%d.%d\n", (i * 7919) % 65521, i
+}' > lookup-keys.txt
+lookup ./lookup-keys.txt || exit 1
+lookup ./lookup-keys.txt --algo=chd || exit 1
+rm -f -- lookup-keys.txt
+## batches that don't divide the number of lookups
+xflags="-DPH_BATCH=7U"
+lookup lens.txt --hash=wy || exit 1
+lookup ckw.txt --hash=bob --minimal || exit 1
+lookup gnukw.txt --hash=wy --layout=inline || exit 1
+xflags=""
+rm -f -- "${gen}" lookup-bin
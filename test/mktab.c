@@ -0,0 +1,148 @@
+/*** mktab.c -- phtups_mktab() against the quadratic check
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of phashist.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+/* for the static routines */
+#include "phfind.c"
+
+/* salts to try per hash and table geometry */
+#define NSALT	(2048U)
+
+static size_t
+quadratic(phtups_t tups)
+{
+/* the collision check phtups_mktab() used to do,
+ * compare every key against every other key */
+	const size_t n = tups->keys->n;
+	size_t ncoll = 0U;
+
+	for (size_t i = 0U; i < n; i++) {
+		for (size_t j = 0U; j < n; j++) {
+			if (i == j) {
+				continue;
+			} else if (tups->tups[i].b != tups->tups[j].b) {
+				continue;
+			} else if (tups->tups[i].a == tups->tups[j].a) {
+				ncoll++;
+			}
+		}
+	}
+	return ncoll;
+}
+
+static int
+salts(phvec_t keys, phfun_t f, unsigned int ashift, unsigned int bshift,
+      size_t *nacc, size_t *nrej)
+{
+/* check that phtups_mktab() accepts the same salts as the quadratic
+ * check for the default geometry with alen and blen halved ASHIFT and
+ * BSHIFT times */
+	phtups_t t = make_tups(keys, 1U, f);
+	int rc = 0;
+
+	t->quiet = true;
+	t->alen = t->alen >> ashift ?: 1U;
+	t->blen = t->blen >> bshift ?: 1U;
+	for (phash_t s = 1U; s <= NSALT; s++) {
+		bool newp, oldp;
+
+		phtups_phash(t, s);
+		newp = phtups_mktab(t, false) == 0U;
+		oldp = quadratic(t) == 0U;
+		if (newp != oldp) {
+			fprintf(stderr, "\
+hash %s, alen %zu, blen %zu, salt %lu: %s now, %s before\n",
+				phash_name(f), t->alen, t->blen, s,
+				newp ? "accepted" : "rejected",
+				oldp ? "accepted" : "rejected");
+			rc = 1;
+		} else if ((phtups_mktab(t, true) == 0U) != oldp) {
+			fprintf(stderr, "\
+hash %s, alen %zu, blen %zu, salt %lu: thorough check disagrees\n",
+				phash_name(f), t->alen, t->blen, s);
+			rc = 1;
+		}
+		*nacc += oldp;
+		*nrej += !oldp;
+	}
+	free_tups(t);
+	return rc;
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const phfun_t fs[] = {PHASH_BOB, PHASH_ICKE2, PHASH_OAT};
+	int rc = 0;
+
+	if (argc < 2) {
+		fputs("Usage: mktab KEYS...\n", stderr);
+		return 1;
+	}
+	for (int i = 1; i < argc; i++) {
+		phvec_t keys = ph_read_keys(argv[i]);
+		size_t nacc = 0U;
+		size_t nrej = 0U;
+
+		if (keys == NULL) {
+			perror("cannot read keys");
+			return 1;
+		}
+		for (size_t j = 0U; j < countof(fs); j++) {
+			for (unsigned int a = 0U; a < 3U; a++) {
+				for (unsigned int b = 0U; b < 3U; b++) {
+					rc |= salts(keys, fs[j], a, b,
+						    &nacc, &nrej);
+				}
+			}
+		}
+		if (!nacc || !nrej) {
+			/* can't tell anything apart */
+			fprintf(stderr, "\
+%s: %zu salts accepted, %zu rejected\n", argv[i], nacc, nrej);
+			rc = 1;
+		}
+		ph_free_keys(keys);
+	}
+	return rc;
+}
+
+/* mktab.c ends here */
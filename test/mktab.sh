@@ -0,0 +1,4 @@
+#!/bin/sh
+## check that phtups_mktab() accepts exactly the salts that the
+## quadratic collision check it replaced accepts
+./mktab "${srcdir}/ckw.txt" "${srcdir}/gnukw.txt" "${srcdir}/lens.txt"
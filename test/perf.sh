@@ -0,0 +1,39 @@
+#!/bin/sh
+## time the hash routines on few samples, perf must report every one
+## with sane figures and must honour --hash, --iterations and --cycles
+out="perf-out.txt"
+
+## figures() NCOL, the header and NCOL-column rows of positive figures
+## with the 99th percentile no less than the median
+figures()
+{
+	awk -v ncol="${1}" '
+NR == 1 && ($1 != "hash" || $2 != "ns/hash" || NF != ncol) { exit 1 }
+NR > 1 && (NF != ncol || !($2 > 0) || !($3 >= $2) || !($4 > 0)) { exit 1 }
+NR > 1 && ncol > 5 && !($7 >= $6 && $6 > 0) { exit 1 }
+END { if (NR < 2) exit 1 }' "${out}" || { cat "${out}"; return 1; }
+}
+
+"${PHASHIST}" perf --iterations=3 "${srcdir}/ckw.txt" > "${out}" || exit 1
+figures 5 || { echo "perf: bad figures"; exit 1; }
+for h in bob jsw icke2 oat murmur bingo crc32c aes wy; do
+	grep -q "^${h}[/ ]" "${out}" || { echo "perf: no ${h}"; exit 1; }
+done
+
+"${PHASHIST}" perf --hash=wy --iterations=3 "${srcdir}/ckw.txt" > "${out}" || \
+	exit 1
+figures 5 || { echo "perf --hash=wy: bad figures"; exit 1; }
+test "$(grep -vc "^wy " "${out}")" = 1 || \
+	{ echo "perf --hash=wy: other hashes timed"; exit 1; }
+
+## machines without a cycle counter refuse --cycles
+if "${PHASHIST}" perf --cycles --hash=wy --iterations=3 \
+	"${srcdir}/ckw.txt" > "${out}" 2>/dev/null; then
+	figures 7 || { echo "perf --cycles: bad figures"; exit 1; }
+fi
+
+"${PHASHIST}" perf --iterations=0 "${srcdir}/ckw.txt" > /dev/null 2>&1 && \
+	{ echo "--iterations=0 accepted"; exit 1; }
+"${PHASHIST}" perf --hash=xyz "${srcdir}/ckw.txt" > /dev/null 2>&1 && \
+	{ echo "--hash=xyz accepted"; exit 1; }
+rm -f -- "${out}"
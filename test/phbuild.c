@@ -0,0 +1,166 @@
+/*** phbuild.c -- build tables in-process and look up their keys
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of phashist.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+/* nothing but the public API */
+#include "phashist.h"
+
+static char **keys;
+static size_t *lens;
+static size_t nkeys;
+
+static int
+lookups(const ph_opt_t *opt, const char *what)
+{
+/* build a table over KEYS with options OPT, every key must map to its
+ * index, every key changed in one byte must not be found */
+	ph_table_t t;
+	char s[256U];
+	int rc = 0;
+
+	if ((t = ph_build((const char *const*)keys, lens, nkeys, opt)) == NULL) {
+		fprintf(stderr, "%s: %s\n", what, strerror(errno));
+		return 1;
+	}
+	for (size_t i = 0U; i < nkeys; i++) {
+		const size_t z = lens[i];
+		size_t j;
+
+		if ((j = ph_lookup(t, keys[i], z)) != i) {
+			fprintf(stderr, "%s: `%s' gave %zd, expected %zu\n",
+				what, keys[i], (ssize_t)j, i);
+			rc = 1;
+		}
+		memcpy(s, keys[i], z);
+		s[z / 2U] ^= 0x01;
+		if ((j = ph_lookup(t, s, z)) != PH_NOTFOUND ||
+		    (j = ph_lookup(t, s, z - 1U)) != PH_NOTFOUND) {
+			fprintf(stderr, "%s: non-key `%.*s' gave %zu\n",
+				what, (int)z, s, j);
+			rc = 1;
+		}
+		if (ph_payload(t, i) != NULL) {
+			fprintf(stderr, "%s: payload without values\n", what);
+			rc = 1;
+		}
+	}
+	if (ph_lookup(t, "", 0U) != PH_NOTFOUND) {
+		fprintf(stderr, "%s: the empty string was found\n", what);
+		rc = 1;
+	}
+	ph_free(t);
+	return rc;
+}
+
+static int
+refused(const char *const *k, size_t n, const ph_opt_t *opt, int exp,
+	const char *what)
+{
+/* ph_build() must refuse to build a table over K with OPT, and say EXP */
+	ph_table_t t;
+
+	errno = 0;
+	if ((t = ph_build(k, NULL, n, opt)) != NULL) {
+		fprintf(stderr, "table with %s built\n", what);
+		ph_free(t);
+		return 1;
+	} else if (errno != exp) {
+		fprintf(stderr, "table with %s: %s\n", what, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const char *const dups[] = {"foo", "bar", "foo"};
+	char ln[256U];
+	FILE *f;
+	int rc = 0;
+
+	if (argc < 2) {
+		fputs("Usage: phbuild KEYS\n", stderr);
+		return 1;
+	} else if ((f = fopen(argv[1], "r")) == NULL) {
+		perror("cannot open keys");
+		return 1;
+	}
+	while (fgets(ln, sizeof(ln), f) != NULL) {
+		const size_t z = strcspn(ln, "\n");
+
+		keys = realloc(keys, (nkeys + 1U) * sizeof(*keys));
+		lens = realloc(lens, (nkeys + 1U) * sizeof(*lens));
+		/* not NUL-terminated, the lengths must do */
+		keys[nkeys] = malloc(z);
+		memcpy(keys[nkeys], ln, z);
+		lens[nkeys++] = z;
+	}
+	fclose(f);
+
+	rc |= lookups(NULL, "the defaults");
+	rc |= lookups(&(ph_opt_t){.hash = "bob"}, "--hash=bob");
+	rc |= lookups(&(ph_opt_t){.hash = "icke2"}, "--hash=icke2");
+	rc |= lookups(&(ph_opt_t){.algo = "chd"}, "--algo=chd");
+	rc |= lookups(&(ph_opt_t){.hash = "oat", .algo = "chd"},
+		      "--hash=oat --algo=chd");
+	rc |= lookups(&(ph_opt_t){.njobs = 4U}, "--jobs=4");
+
+	rc |= refused(dups, sizeof(dups) / sizeof(*dups), NULL, EEXIST,
+		      "duplicate keys");
+	rc |= refused(dups, 2U, &(ph_opt_t){.hash = "xyz"}, EINVAL,
+		      "an unknown hash");
+	rc |= refused(dups, 2U, &(ph_opt_t){.algo = "xyz"}, EINVAL,
+		      "an unknown algo");
+	rc |= refused(dups, 2U, &(ph_opt_t){.hash = "icke2", .algo = "chd"},
+		      EINVAL, "chd and icke2");
+
+	for (size_t i = 0U; i < nkeys; i++) {
+		free(keys[i]);
+	}
+	free(keys);
+	free(lens);
+	return rc;
+}
+
+/* phbuild.c ends here */
@@ -0,0 +1,5 @@
+#!/bin/sh
+## build tables through libphashist and look up their keys
+./phbuild "${srcdir}/ckw.txt" || exit 1
+./phbuild "${srcdir}/gnukw.txt" || exit 1
+./phbuild "${srcdir}/lens.txt" || exit 1
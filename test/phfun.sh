@@ -0,0 +1,27 @@
+#!/bin/sh
+## compile the hash function emitted for each --hash and check that it
+## hashes keys of all lengths like the builder's own, phashist print
+keys="${srcdir}/lens.txt"
+gen="phfun-gen.c"
+
+## the portable code and, where the cpu has them, the intrinsics
+set -- ""
+if grep -q '^flags.* aes' /proc/cpuinfo 2>/dev/null && \
+	grep -q '^flags.* sse4_2' /proc/cpuinfo; then
+	set -- "" "-maes -msse4.2"
+fi
+
+for h in oat bingo icke2 jsw bob murmur crc32c aes wy; do
+	"${PHASHIST}" build --hash="${h}" "${keys}" > "${gen}" 2>/dev/null || \
+		{ echo "--hash=${h}: no table"; exit 1; }
+	"${PHASHIST}" print --hash="${h}" "${keys}" > phfun-exp || exit 1
+	for f; do
+		${CC} ${CFLAGS} ${f} -I. -DPH_GEN="\"${gen}\"" \
+			-o phfun-bin "${srcdir}/phfun.c" || exit 1
+		./phfun-bin < "${keys}" | diff -u phfun-exp - || {
+			echo "--hash=${h} ${f}"
+			exit 1
+		}
+	done
+done
+rm -f -- "${gen}" phfun-bin phfun-exp
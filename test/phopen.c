@@ -0,0 +1,288 @@
+/*** phopen.c -- open binary tables, intact and broken ones
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of phashist.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include "phashist.h"
+#include "phblob.h"
+
+static const char *bad = "phopen-bad.bin";
+
+static int
+look(ph_table_t t, const char *s, size_t z, size_t exp)
+{
+	const size_t i = ph_lookup(t, s, z);
+
+	if (i != exp) {
+		fprintf(stderr, "`%.*s' gave %zd, expected %zd\n",
+			(int)z, s, (ssize_t)i, (ssize_t)exp);
+		return 1;
+	}
+	return 0;
+}
+
+static int
+lookups(const char *blob, const char *fn)
+{
+/* look up the lines KEY<TAB>VALUE of FN in BLOB, every key must map to
+ * its line number and payload, every key changed in one byte must not
+ * be found, the keys are assumed to differ in more than one byte */
+	char ln[256U];
+	ph_table_t t;
+	size_t n = 0U;
+	int rc = 0;
+	FILE *f;
+
+	if ((t = ph_open(blob)) == NULL) {
+		perror("cannot open table");
+		return 1;
+	} else if ((f = fopen(fn, "r")) == NULL) {
+		perror("cannot open keys");
+		ph_free(t);
+		return 1;
+	}
+	for (; fgets(ln, sizeof(ln), f) != NULL; n++) {
+		const size_t z = strcspn(ln, "\t\n");
+		const char *v = ln[z] == '\t' ? ln + z + 1U : "";
+		const size_t vz = strcspn(v, "\n");
+		const char *p = ph_payload(t, n);
+
+		rc |= look(t, ln, z, n);
+		if (p == NULL || strlen(p) != vz || memcmp(p, v, vz)) {
+			fprintf(stderr, "payload of `%.*s' is `%s'\n",
+				(int)z, ln, p ? p : "(null)");
+			rc = 1;
+		}
+		rc |= look(t, ln, z - 1U, PH_NOTFOUND);
+		ln[z] = 'x';
+		rc |= look(t, ln, z + 1U, PH_NOTFOUND);
+		ln[z / 2U] ^= 0x01;
+		rc |= look(t, ln, z, PH_NOTFOUND);
+	}
+	rc |= look(t, "", 0U, PH_NOTFOUND);
+	rc |= ph_payload(t, n) != NULL;
+	fclose(f);
+	ph_free(t);
+	return rc;
+}
+
+static void
+put32(uint8_t *b, uint64_t off, size_t i, uint32_t v)
+{
+	v = htole32(v);
+	memcpy(b + off + i * sizeof(v), &v, sizeof(v));
+	return;
+}
+
+static uint32_t
+get32(const uint8_t *b, uint64_t off, size_t i)
+{
+	uint32_t v;
+
+	memcpy(&v, b + off + i * sizeof(v), sizeof(v));
+	return le32toh(v);
+}
+
+static int
+broken(const uint8_t *b, size_t z, const char *what)
+{
+/* write the Z bytes of B to a file, ph_open() must refuse it */
+	FILE *f = fopen(bad, "w");
+	ph_table_t t;
+
+	if (f == NULL) {
+		return 1;
+	}
+	fwrite(b, 1, z, f);
+	fclose(f);
+	errno = 0;
+	if ((t = ph_open(bad)) != NULL) {
+		fprintf(stderr, "table with %s opened\n", what);
+		ph_free(t);
+		return 1;
+	} else if (errno != EINVAL) {
+		fprintf(stderr, "table with %s: %s\n", what, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+static int
+damaged(const uint8_t *b, const uint8_t *c, size_t z, const char *what,
+	size_t from, size_t till, bool keysp)
+{
+/* write the Z bytes of C, a damaged copy of blob B, to a file, ph_open()
+ * must accept it, the keys in [FROM, TILL) must not be found if KEYSP,
+ * their payloads must be NULL otherwise, everything else must be as in B */
+	FILE *f = fopen(bad, "w");
+	phblob_hdr_t h;
+	ph_table_t t;
+	int rc = 0;
+
+	if (f == NULL) {
+		return 1;
+	}
+	fwrite(c, 1, z, f);
+	fclose(f);
+	if ((t = ph_open(bad)) == NULL) {
+		fprintf(stderr, "table with %s: %s\n", what, strerror(errno));
+		return 1;
+	}
+	memcpy(&h, b, sizeof(h));
+	phblob_hdr_swap(&h);
+	for (size_t i = 0U; i < h.nkeys; i++) {
+		const uint32_t ko = get32(b, h.koff, i);
+		const uint32_t vo = get32(b, h.voff, i);
+		const char *k = (const char*)b + h.pool + ko;
+		const char *v = (const char*)b + h.vpool + vo;
+		const bool lostp = i >= from && i < till;
+		const char *p = ph_payload(t, i);
+
+		rc |= look(t, k, get32(b, h.koff, i + 1U) - ko - 1U,
+			   lostp && keysp ? PH_NOTFOUND : i);
+		if (lostp && !keysp ? p != NULL : p == NULL || strcmp(p, v)) {
+			fprintf(stderr, "table with %s: payload %zu is `%s'\n",
+				what, i, p ? p : "(null)");
+			rc = 1;
+		}
+	}
+	rc |= look(t, "", 0U, PH_NOTFOUND);
+	ph_free(t);
+	return rc;
+}
+
+static int
+breakage(const char *blob)
+{
+/* break copies of BLOB in various ways */
+	FILE *f = fopen(blob, "r");
+	phblob_hdr_t h;
+	uint8_t *b, *c;
+	uint32_t j;
+	size_t z;
+	int rc = 0;
+
+	if (f == NULL) {
+		return 1;
+	}
+	fseek(f, 0, SEEK_END);
+	z = ftell(f);
+	rewind(f);
+	b = malloc(z);
+	c = malloc(z);
+	if (fread(b, 1, z, f) != z || z < sizeof(h)) {
+		fclose(f);
+		return 1;
+	}
+	fclose(f);
+	memcpy(&h, b, sizeof(h));
+	phblob_hdr_swap(&h);
+	if (h.nkeys < 2U || !h.voff) {
+		fputs("need a table of keys with payloads\n", stderr);
+		return 1;
+	}
+
+	rc |= broken(b, sizeof(h) - 1U, "a short header");
+
+	memcpy(c, b, z);
+	c[0U] ^= 0x01;
+	rc |= broken(c, z, "a bad magic");
+
+	/* hashes of a different width don't lead to the same slots */
+	memcpy(c, b, z);
+	put32(c, 0U, offsetof(phblob_hdr_t, hbits) / sizeof(uint32_t),
+	      h.hbits == 32U ? 64U : 32U);
+	rc |= broken(c, z, "hash words of another width");
+
+	memcpy(c, b, z);
+	memset(c + offsetof(phblob_hdr_t, voff), 0, sizeof(h.voff));
+	rc |= broken(c, z, "payloads without offsets");
+
+	/* offsets are checked upon use, only the keys they affect suffer */
+	memcpy(c, b, z);
+	put32(c, h.koff, 0U, 0x40000000U);
+	put32(c, h.koff, 1U, 0x40000005U);
+	rc |= damaged(b, c, z, "key offsets beyond the pool", 0U, 2U, true);
+
+	memcpy(c, b, z);
+	put32(c, h.koff, 1U, get32(b, h.koff, 0U));
+	rc |= damaged(b, c, z, "an empty key", 0U, 2U, true);
+
+	memcpy(c, b, z);
+	put32(c, h.voff, h.nkeys, (uint32_t)(h.size - h.vpool + 1U));
+	rc |= damaged(b, c, z, "payload offsets beyond the pool",
+		      h.nkeys - 1U, h.nkeys, false);
+
+	memcpy(c, b, z);
+	c[h.vpool + get32(b, h.voff, h.nkeys) - 1U] = 'x';
+	rc |= damaged(b, c, z, "an unterminated payload",
+		      h.nkeys - 1U, h.nkeys, false);
+
+	/* slots beyond the keys are vacant, so is the key of this one */
+	memcpy(c, b, z);
+	j = get32(b, h.kix, h.smax - 1U);
+	put32(c, h.kix, h.smax - 1U, h.nkeys + 1U);
+	rc |= damaged(b, c, z, "a slot beyond the keys", j, j + 1U, true);
+
+	remove(bad);
+	free(b);
+	free(c);
+	return rc;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int rc = 0;
+
+	if (argc < 3) {
+		fputs("Usage: phopen BLOB KEYS\n", stderr);
+		return 1;
+	}
+	rc |= lookups(argv[1], argv[2]);
+	rc |= breakage(argv[1]);
+	return rc;
+}
+
+/* phopen.c ends here */
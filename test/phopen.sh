@@ -0,0 +1,18 @@
+#!/bin/sh
+## write binary tables and look up their keys through libphashist
+blob="phopen.bin"
+
+for a in bob chd; do
+	"${PHASHIST}" build --format=bin --algo="${a}" --value-type=int \
+		"${srcdir}/ckv.txt" > "${blob}" 2>/dev/null || \
+		{ echo "--algo=${a}: no table"; exit 1; }
+	./phopen "${blob}" "${srcdir}/ckv.txt" || { echo "--algo=${a}"; exit 1; }
+done
+## duplicate keys leave nothing to write
+printf 'foo\tbar\nfoo\tbaz\n' | "${PHASHIST}" build --format=bin \
+	--value-type=int > "${blob}" 2>/dev/null && \
+	{ echo "duplicate keys: table written"; exit 1; }
+test -s "${blob}" && { echo "duplicate keys: blob not empty"; exit 1; }
+"${PHASHIST}" build --format=xyz "${srcdir}/ckv.txt" > /dev/null 2>&1 && \
+	{ echo "--format=xyz accepted"; exit 1; }
+rm -f -- "${blob}"
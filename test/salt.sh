@@ -0,0 +1,44 @@
+#!/bin/sh
+## build tables over the C keywords and compare salt, table and
+## slots against known good ones
+for h in bob icke2 oat; do
+	"${PHASHIST}" build --hash="${h}" "${srcdir}/ckw.txt" 2>/dev/null | \
+		sed -n '/ salt = /p
+/ tab\[\] = {/,/^};/p
+/ [abs]log = /p
+/ ph_kw\[.*\] = {/,/^};/p' | \
+		diff -u "${srcdir}/ckw-${h}.tab" - || exit 1
+done
+## the lowest salt wins no matter how many threads search for it,
+## the larger key sets keep the threads busy long enough to overlap
+samesalt()
+{
+	keys="${1}"
+	shift
+	"${PHASHIST}" build --jobs=1 "$@" "${keys}" > salt-j1.c 2>/dev/null || \
+		{ echo "$*: no table"; return 1; }
+	for j in 2 4 8; do
+		"${PHASHIST}" build --jobs="${j}" "$@" "${keys}" \
+			> salt-jn.c 2>/dev/null || return 1
+		cmp salt-j1.c salt-jn.c || { echo "$* --jobs=${j}"; return 1; }
+	done
+}
+
+for k in ckw gnukw lens; do
+	for h in bob icke2 jsw oat; do
+		samesalt "${srcdir}/${k}.txt" --hash="${h}" || exit 1
+	done
+done
+for n in 10000 30000; do
+	awk -v n="${n}" 'BEGIN {
+		for (i = 0; i < n; i++) printf "%d.%d\n", (i * 7919) % 65521, i
+	}' > salt-keys.txt
+	for h in bob oat wy crc32c; do
+		samesalt salt-keys.txt --hash="${h}" || exit 1
+	done
+done
+rm -f -- salt-j1.c salt-jn.c salt-keys.txt
+
+"${PHASHIST}" build --jobs=0 "${srcdir}/ckw.txt" > /dev/null 2>&1 && \
+	{ echo "--jobs=0 accepted"; exit 1; }
+exit 0